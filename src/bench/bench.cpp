@@ -0,0 +1,255 @@
+#include "core/cpu.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Core microbenchmarks on fixed synthetic workloads, so two builds can be
+ * compared run for run:
+ *
+ *  - alu:    register-only ALU loop
+ *  - copy:   load/store/increment loop through the bus
+ *  - banks:  MBC5 ROM bank switch and banked read every iteration
+ *  - ppu:    CPU halted, LCD rendering background, window and 40 sprites
+ *  - mmu.at: raw bus reads over ROM, WRAM, HRAM and IO, outside the CPU
+ *
+ * Every CPU workload runs for the same guest time; each is repeated and
+ * the fastest run is reported as guest MIPS, frames/s and speed over real
+ * time. --json prints one object for regression tracking.
+ *
+ * usage: gboy-bench [--json] [--repeat N] [--seconds guest-seconds]
+ *                   [--only name]
+ */
+
+namespace {
+using namespace mpu;
+
+constexpr u16 ENTRY = 0x0100;
+
+struct result {
+  std::string name;
+  double mips = 0.0;   // guest instructions per host microsecond
+  double fps = 0.0;    // guest frames per host second
+  double speed = 0.0;  // guest time over host time
+  double ns_per_op = 0.0;
+  double seconds = 0.0; // host time of the best run
+};
+
+auto cartridge(u8 _type, std::size_t _banks, const std::vector<u8> &_program)
+    -> std::vector<u8> {
+  std::vector<u8> rom(_banks * cartridge::ROM_BANK);
+  rom[cartridge::TYPE] = _type;
+  std::copy(_program.begin(), _program.end(), rom.begin() + ENTRY);
+  return rom;
+}
+
+// register-only loop body closed by a JR back to the start
+auto alu(CPU &_cpu) -> void {
+  _cpu.get_bus().load_rom(cartridge(0x00, 2,
+                                    {
+                                        0x47,       // LD B, A
+                                        0x3C,       // INC A
+                                        0x80,       // ADD A, B
+                                        0xA9,       // XOR A, C
+                                        0x4F,       // LD C, A
+                                        0x15,       // DEC D
+                                        0xB2,       // OR A, D
+                                        0x91,       // SUB A, C
+                                        0x5F,       // LD E, A
+                                        0x8B,       // ADC A, E
+                                        0xA4,       // AND A, H
+                                        0x2C,       // INC L
+                                        0x9D,       // SBC A, L
+                                        0xBB,       // CP A, E
+                                        0x18, 0xF0, // JR -16
+                                    }));
+}
+
+// 256 iterations of load, store and pointer increments, then restart
+auto copy(CPU &_cpu) -> void {
+  _cpu.get_bus().load_rom(cartridge(0x00, 2,
+                                    {
+                                        0x26, 0xC0, // LD H, 0xC0
+                                        0x2E, 0x00, // LD L, 0x00
+                                        0x16, 0xD0, // LD D, 0xD0
+                                        0x1E, 0x00, // LD E, 0x00
+                                        0x0E, 0x00, // LD C, 0
+                                        0x2A,       // LD A, [HL+]
+                                        0x12,       // LD [DE], A
+                                        0x13,       // INC DE
+                                        0x0D,       // DEC C
+                                        0x20, 0xFA, // JR NZ, -6
+                                        0x18, 0xEE, // JR -18
+                                    }));
+}
+
+// a bank switch and a read from the switched bank every iteration, over a
+// 1 MiB MBC5 cartridge
+auto banks(CPU &_cpu) -> void {
+  _cpu.get_bus().load_rom(cartridge(0x19, 64,
+                                    {
+                                        0x04,             // INC B
+                                        0x78,             // LD A, B
+                                        0xEA, 0x00, 0x20, // LD [0x2000], A
+                                        0xFA, 0x00, 0x40, // LD A, [0x4000]
+                                        0x18, 0xF6,       // JR -10
+                                    }));
+}
+
+// busy scene for the renderer while the CPU sleeps in HALT
+auto ppu_scene(CPU &_cpu) -> void {
+  auto &bus = _cpu.get_bus();
+  bus.load_rom(cartridge(0x00, 2,
+                         {
+                             0x76,       // HALT
+                             0x18, 0xFD, // JR -3
+                         }));
+  for (std::size_t i = 0; i < 0x1800; ++i) // tile data: stripes
+    bus.vram[i] = static_cast<u8>(i * 0x5B + (i >> 4));
+  for (std::size_t i = 0x1800; i < 0x2000; ++i) // both tile maps
+    bus.vram[i] = static_cast<u8>(i * 7);
+  for (u16 i = 0; i < 40; ++i) { // every sprite, ten per line somewhere
+    bus.oam[i * 4] = static_cast<u8>(16 + (i / 10) * 36);
+    bus.oam[i * 4 + 1] = static_cast<u8>(8 + (i % 10) * 16);
+    bus.oam[i * 4 + 2] = static_cast<u8>(i);
+    bus.oam[i * 4 + 3] = static_cast<u8>((i & 3) << 5);
+  }
+  bus.set_u8(ppu::WY, 72);
+  bus.set_u8(ppu::WX, 87);
+  bus.set_u8(ppu::LCDC, 0xF3); // LCD, window (9C00), 8000 tiles, OBJ, BG
+  bus.interrupt_enable = 0;    // nothing wakes the HALT
+}
+
+auto mips(u64 _instructions, double _seconds) -> double {
+  return _seconds > 0 ? static_cast<double>(_instructions) / _seconds / 1e6
+                      : 0.0;
+}
+
+auto run_cpu(const char *_name, void (*_setup)(CPU &), u64 _cycles,
+             int _repeat) -> result {
+  result best{_name};
+  for (int run = 0; run < _repeat; ++run) {
+    auto cpu = std::make_unique<CPU>();
+    _setup(*cpu);
+    cpu->set_pc(ENTRY);
+    cpu->set_audio_enabled(false);
+    auto &bus = cpu->get_bus();
+
+    u64 instructions = 0;
+    const u64 frames = bus.video.frames;
+    const auto start = clk::now();
+    while (bus.clock < _cycles) {
+      cpu->step();
+      ++instructions;
+    }
+    const double seconds =
+        std::chrono::duration<double>(clk::now() - start).count();
+
+    if (run == 0 || seconds < best.seconds) {
+      best.seconds = seconds;
+      best.mips = mips(instructions, seconds);
+      best.fps = static_cast<double>(bus.video.frames - frames) / seconds;
+      best.speed = static_cast<double>(bus.clock) / apu::CLOCK_RATE / seconds;
+    }
+  }
+  return best;
+}
+
+// bus reads in isolation: a strided walk that touches every region type
+auto run_at(int _repeat) -> result {
+  constexpr u16 BASES[] = {0x0150, 0x4150, 0xC000, 0xD000, 0xFF80, 0xFF40};
+  constexpr u64 READS = 1u << 24;
+  result best{"mmu.at"};
+
+  auto cpu = std::make_unique<CPU>();
+  const mmu &bus = cpu->get_bus();
+  for (int run = 0; run < _repeat; ++run) {
+    u32 sum = 0;
+    const auto start = clk::now();
+    for (u64 i = 0; i < READS; ++i)
+      sum += bus.at(static_cast<u16>(BASES[i % 6] + (i >> 3 & 0x3F)));
+    const double seconds =
+        std::chrono::duration<double>(clk::now() - start).count();
+    // keeps the reads from being optimised away
+    asm volatile("" : : "r"(sum));
+
+    if (run == 0 || seconds < best.seconds) {
+      best.seconds = seconds;
+      best.ns_per_op = seconds * 1e9 / static_cast<double>(READS);
+    }
+  }
+  return best;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  bool json = false;
+  int repeat = 5;
+  double guest_seconds = 10.0;
+  std::string only;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--json")
+      json = true;
+    else if (arg == "--repeat" && i + 1 < argc)
+      repeat = std::max(1, std::atoi(argv[++i]));
+    else if (arg == "--seconds" && i + 1 < argc)
+      guest_seconds = std::atof(argv[++i]);
+    else if (arg == "--only" && i + 1 < argc)
+      only = argv[++i];
+    else {
+      std::cerr << "usage: gboy-bench [--json] [--repeat N] "
+                   "[--seconds guest-seconds] [--only name]"
+                << std::endl;
+      return 2;
+    }
+  }
+  const auto cycles = static_cast<u64>(guest_seconds * apu::CLOCK_RATE);
+
+  const struct {
+    const char *name;
+    void (*setup)(CPU &);
+  } workloads[] = {
+      {"alu", alu}, {"copy", copy}, {"banks", banks}, {"ppu", ppu_scene}};
+
+  std::vector<result> results;
+  try {
+    for (const auto &workload : workloads)
+      if (only.empty() || only == workload.name)
+        results.push_back(run_cpu(workload.name, workload.setup, cycles, repeat));
+    if (only.empty() || only == "mmu.at")
+      results.push_back(run_at(repeat));
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
+  if (json) {
+    std::printf("{\"guest_seconds\": %g, \"repeat\": %d, \"results\": [",
+                guest_seconds, repeat);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const result &r = results[i];
+      std::printf("%s\n  {\"name\": \"%s\", \"mips\": %.3f, \"fps\": %.2f, "
+                  "\"speed\": %.3f, \"ns_per_op\": %.3f, \"seconds\": %.6f}",
+                  i ? "," : "", r.name.c_str(), r.mips, r.fps, r.speed,
+                  r.ns_per_op, r.seconds);
+    }
+    std::printf("\n]}\n");
+    return 0;
+  }
+
+  std::printf("%-8s %10s %10s %9s %10s\n", "", "MIPS", "frames/s", "speed",
+              "ns/op");
+  for (const result &r : results) {
+    if (r.ns_per_op > 0)
+      std::printf("%-8s %10s %10s %9s %10.3f\n", r.name.c_str(), "-", "-", "-",
+                  r.ns_per_op);
+    else
+      std::printf("%-8s %10.2f %10.1f %8.1fx %10s\n", r.name.c_str(), r.mips,
+                  r.fps, r.speed, "-");
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include "core/cpu.hpp"
+#include "core/lockstep.hpp"
+#include "core/state_io.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+ * Aggregate MIPS of the lockstep engine against N independent instances
+ * running the same register-heavy loop. Every lane must end in exactly
+ * the state (registers, bus, peripherals) of its independent instance,
+ * otherwise the lane is reported and the benchmark fails.
+ *
+ * usage: gboy-lockstep-bench [steps per lane]
+ */
+
+namespace {
+using namespace mpu;
+
+// register-only loop body closed by a JR back to the start; the JR is the
+// only instruction that takes the scalar path in lockstep
+constexpr u8 PROGRAM[] = {
+    0x47, // LD B, A
+    0x3C, // INC A
+    0x80, // ADD A, B
+    0xA9, // XOR A, C
+    0x4F, // LD C, A
+    0x15, // DEC D
+    0xB2, // OR A, D
+    0x91, // SUB A, C
+    0x5F, // LD E, A
+    0x8B, // ADC A, E
+    0xA4, // AND A, H
+    0x2C, // INC L
+    0x9D, // SBC A, L
+    0x00, // NOP
+    0xBB, // CP A, E
+    0x18, 0xEF, // JR -17
+};
+
+auto load(CPU &_cpu, u8 _seed) -> void {
+  std::vector<u8> rom(2 * cartridge::ROM_BANK);
+  std::copy(std::begin(PROGRAM), std::end(PROGRAM), rom.begin() + 0x100);
+  _cpu.get_bus().load_rom(rom);
+  _cpu.set_pc(0x0100);
+  _cpu.set_acc(_seed);
+  _cpu.set_c(static_cast<u8>(_seed * 3));
+  _cpu.set_d(static_cast<u8>(_seed * 7));
+  _cpu.set_h(static_cast<u8>(_seed ^ 0x5A));
+}
+
+auto mips(u64 _instructions, clk::duration _elapsed) -> double {
+  const auto us = std::chrono::duration<double, std::micro>(_elapsed).count();
+  return us > 0 ? static_cast<double>(_instructions) / us : 0.0;
+}
+
+// encoded snapshot, see state_io.hpp
+auto state_of(const CPU &_cpu) -> std::vector<u8> {
+  const auto state = std::make_unique<CPU::snapshot>();
+  _cpu.save(*state);
+  std::vector<u8> bytes;
+  encode_state(*state, bytes);
+  return bytes;
+}
+
+// lanes whose final state differs from their independent instance
+template <std::size_t LANES>
+auto mismatches(lockstep<LANES> &_engine, const std::vector<CPU> &_cpus)
+    -> std::size_t {
+  _engine.sync_to_lanes();
+  std::size_t failed = 0;
+  for (std::size_t i = 0; i < LANES; ++i) {
+    const std::vector<u8> ours = state_of(_engine.lanes[i]);
+    const std::vector<u8> theirs = state_of(_cpus[i]);
+    if (ours == theirs)
+      continue;
+    ++failed;
+    const auto at = std::mismatch(ours.begin(), ours.end(), theirs.begin());
+    std::cout << "  lane " << i << " diverges at state byte "
+              << at.first - ours.begin() << " (pc " << _engine.lanes[i].get_pc()
+              << " vs " << _cpus[i].get_pc() << ")\n";
+  }
+  return failed;
+}
+
+template <std::size_t LANES> auto run(u64 _steps) -> bool {
+  // independent instances, stepped one after another
+  std::vector<CPU> cpus(LANES);
+  for (std::size_t i = 0; i < LANES; ++i)
+    load(cpus[i], static_cast<u8>(i));
+
+  auto start = clk::now();
+  for (u64 n = 0; n < _steps; ++n)
+    for (auto &cpu : cpus)
+      cpu.step();
+  const auto independent = clk::now() - start;
+
+  // lockstep engine over the same lanes
+  auto engine = std::make_unique<lockstep<LANES>>();
+  for (std::size_t i = 0; i < LANES; ++i)
+    load(engine->lanes[i], static_cast<u8>(i));
+  engine->sync_from_lanes();
+
+  start = clk::now();
+  for (u64 n = 0; n < _steps; ++n)
+    engine->step();
+  const auto together = clk::now() - start;
+
+  const u64 retired = engine->vector_retired + engine->scalar_retired;
+  std::cout << LANES << " lanes\n"
+            << "  independent: " << mips(_steps * LANES, independent)
+            << " MIPS\n"
+            << "  lockstep:    " << mips(retired, together) << " MIPS ("
+            << engine->vector_retired << " vector, " << engine->scalar_retired
+            << " scalar)\n";
+  return mismatches(*engine, cpus) == 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const u64 steps = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+  const bool same = run<8>(steps) & run<16>(steps);
+  if (!same)
+    std::cout << "lockstep lanes differ from independent instances"
+              << std::endl;
+  return same ? 0 : 1;
+}
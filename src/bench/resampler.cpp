@@ -0,0 +1,97 @@
+#include "core/apu.hpp"
+#include "core/cpu.hpp"
+#include "core/resampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * Throughput of the APU output resampler for each available kernel,
+ * converting native APU blocks to a host rate. Exits non-zero when a SIMD
+ * kernel's output drifts from the scalar reference beyond rounding noise.
+ *
+ * usage: gboy-resampler-bench [output rate] [seconds of audio]
+ */
+
+namespace {
+using namespace mpu;
+
+// float reassociation across lanes; anything past this is a kernel bug
+constexpr float TOLERANCE = 1e-5f;
+
+auto name(resampler::isa _isa) -> const char * {
+  switch (_isa) {
+  case resampler::isa::scalar:
+    return "scalar";
+  case resampler::isa::sse2:
+    return "sse2";
+  case resampler::isa::avx2:
+    return "avx2";
+  default:
+    return "best";
+  }
+}
+
+auto run(resampler::isa _isa, u32 _rate, const std::vector<float> &_input,
+         std::vector<float> &_output) -> void {
+  resampler stage(apu::SAMPLE_RATE, _rate, _isa);
+  const u32 chunk = audio_block::FRAMES;
+  std::vector<float> out(stage.max_output(chunk) * 2);
+  _output.clear();
+
+  const auto frames = static_cast<u32>(_input.size() / 2);
+  const auto start = clk::now();
+  for (u32 i = 0; i + chunk <= frames; i += chunk) {
+    const u32 n = stage.process(&_input[i * 2], chunk, out.data(),
+                                static_cast<u32>(out.size() / 2));
+    _output.insert(_output.end(), out.begin(), out.begin() + n * 2);
+  }
+  const auto elapsed = clk::now() - start;
+
+  const auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  const auto produced = static_cast<double>(_output.size() / 2);
+  const double audio_seconds = static_cast<double>(frames) / apu::SAMPLE_RATE;
+  std::cout << "  " << name(stage.kernel()) << ": " << ns / produced
+            << " ns/frame, " << audio_seconds / (ns * 1e-9)
+            << "x real time\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const auto rate =
+      static_cast<u32>(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 48000);
+  const double seconds = argc > 2 ? std::strtod(argv[2], nullptr) : 60.0;
+
+  // band-limited noise plus a tone, roughly what the APU hands over
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> noise(-0.25f, 0.25f);
+  std::vector<float> input(static_cast<std::size_t>(seconds * apu::SAMPLE_RATE) *
+                           2);
+  for (std::size_t i = 0; i < input.size(); i += 2) {
+    const auto t = static_cast<float>(i / 2) / apu::SAMPLE_RATE;
+    input[i] = 0.5f * std::sin(2.0f * 3.14159265f * 440.0f * t) + noise(random);
+    input[i + 1] = noise(random);
+  }
+
+  std::cout << apu::SAMPLE_RATE << " Hz -> " << rate << " Hz, " << seconds
+            << " s of audio\n";
+  std::vector<float> reference;
+  std::vector<float> output;
+  run(resampler::isa::scalar, rate, input, reference);
+  bool ok = true;
+  for (auto isa : {resampler::isa::sse2, resampler::isa::avx2}) {
+    run(isa, rate, input, output);
+    float error = 0.0f;
+    for (std::size_t i = 0; i < std::min(output.size(), reference.size()); ++i)
+      error = std::max(error, std::fabs(output[i] - reference[i]));
+    std::cout << "    max difference from scalar: " << error << "\n";
+    if (output.size() != reference.size() || !(error <= TOLERANCE)) {
+      std::cerr << name(isa) << " output differs from the scalar reference\n";
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,638 @@
+#include "apu.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <thread>
+
+namespace mpu {
+
+namespace {
+
+// windowed-sinc impulse for every sub-sample phase, each phase sums to 1
+const auto BLIP_KERNEL = [] {
+  constexpr u32 PHASES = blip_buffer::PHASES;
+  constexpr u32 WIDTH = blip_buffer::WIDTH;
+  constexpr double CUTOFF = 0.45; // of the sample rate, just below Nyquist
+
+  std::array<std::array<float, WIDTH>, PHASES> kernel{};
+  for (u32 phase = 0; phase < PHASES; ++phase) {
+    std::array<double, WIDTH> taps{};
+    double sum = 0.0;
+
+    for (u32 k = 0; k < WIDTH; ++k) {
+      const double x = static_cast<double>(k) - (WIDTH / 2.0 - 1.0) -
+                       static_cast<double>(phase) / PHASES;
+      const double arg = 2.0 * std::numbers::pi * CUTOFF * x;
+      const double sinc = x == 0.0 ? 1.0 : std::sin(arg) / arg;
+      const double w = (x + WIDTH / 2.0) / WIDTH; // Blackman over the taps
+      const double window = 0.42 - 0.5 * std::cos(2.0 * std::numbers::pi * w) +
+                            0.08 * std::cos(4.0 * std::numbers::pi * w);
+      taps[k] = sinc * window;
+      sum += taps[k];
+    }
+    for (u32 k = 0; k < WIDTH; ++k)
+      kernel[phase][k] = static_cast<float>(taps[k] / sum);
+  }
+  return kernel;
+}();
+
+constexpr float OUTPUT_SCALE = 1.0f / 512.0f; // 4 channels x 15 x volume 8
+constexpr float DC_RATE = 1.0f / 1024.0f;     // high-pass around 10 Hz
+constexpr u32 DECIMATE_FADE = 32;             // frames faded at block edges
+
+constexpr std::array<u8, 4> DUTY = {0b00000001, 0b10000001, 0b10000111,
+                                    0b01111110};
+
+// bits that read back as 1, indexed from NR10
+constexpr std::array<u8, 0x30> READ_MASK = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,                         // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,                         // NR20-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,                         // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,                         // NR40-NR44
+    0x00, 0x00, 0x70,                                     // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // unused
+};
+
+} // namespace
+
+auto blip_buffer::add_delta(u64 _offset, float _delta) -> void {
+  const auto pos = static_cast<u32>(_offset / PHASES);
+  const auto &taps = BLIP_KERNEL[_offset % PHASES];
+  for (u32 k = 0; k < WIDTH; ++k)
+    m_deltas[pos + k] += _delta * taps[k];
+}
+
+auto blip_buffer::read(u32 _count, float *_out) -> void {
+  for (u32 i = 0; i < _count; ++i) {
+    m_integral += m_deltas[i];
+    m_dc += (m_integral - m_dc) * DC_RATE;
+    _out[i * 2] = (m_integral - m_dc) * OUTPUT_SCALE;
+  }
+  std::copy(m_deltas.begin() + _count, m_deltas.end(), m_deltas.begin());
+  std::fill(m_deltas.end() - _count, m_deltas.end(), 0.0f);
+}
+
+auto apu::envelope::load(u8 _nrx2) -> void {
+  initial = _nrx2 >> 4;
+  up = _nrx2 & 0x08;
+  period = _nrx2 & 0x07;
+}
+
+auto apu::envelope::trigger() -> void {
+  volume = initial;
+  timer = period;
+}
+
+auto apu::envelope::clock() -> void {
+  if (period == 0 || --timer != 0)
+    return;
+  timer = period;
+  if (up && volume < 15)
+    ++volume;
+  else if (!up && volume > 0)
+    --volume;
+}
+
+auto apu::square::output() const -> u8 {
+  if (!enabled || !dac)
+    return 0;
+  return (DUTY[duty] >> position) & 1 ? env.volume : 0;
+}
+
+auto apu::read(u16 _addr, u64 _clock) -> u8 {
+  __run_until(_clock);
+
+  const u16 reg = _addr - NR10;
+  if (_addr == NR52) {
+    return (m_power ? 0x80 : 0x00) | 0x70 | (m_square1.enabled ? 0x1 : 0) |
+           (m_square2.enabled ? 0x2 : 0) | (m_wave.enabled ? 0x4 : 0) |
+           (m_noise.enabled ? 0x8 : 0);
+  }
+  if (_addr >= WAVE_RAM)
+    return m_regs[reg];
+  return m_regs[reg] | READ_MASK[reg];
+}
+
+auto apu::write(u16 _addr, u8 _value, u64 _clock) -> void {
+  __run_until(_clock);
+
+  const u16 reg = _addr - NR10;
+  if (_addr >= WAVE_RAM) {
+    m_regs[reg] = _value;
+    return;
+  }
+  if (_addr == NR52) {
+    if (!(_value & 0x80) && m_power)
+      __power_off();
+    else if ((_value & 0x80) && !m_power) {
+      m_power = true;
+      m_step = 0;
+    }
+    return;
+  }
+  if (!m_power)
+    return;
+
+  m_regs[reg] = _value;
+  switch (_addr) {
+  case 0xFF10: // NR10 sweep
+    m_sweep.period = (_value >> 4) & 0x7;
+    m_sweep.down = _value & 0x08;
+    m_sweep.shift = _value & 0x07;
+    break;
+  case 0xFF11: // NR11 duty, length
+    m_square1.duty = _value >> 6;
+    m_square1.length = 64 - (_value & 0x3F);
+    break;
+  case 0xFF12: // NR12 envelope
+    m_square1.env.load(_value);
+    m_square1.dac = _value & 0xF8;
+    m_square1.enabled &= m_square1.dac;
+    break;
+  case 0xFF13: // NR13 frequency low
+    m_square1.frequency = (m_square1.frequency & 0x700) | _value;
+    break;
+  case NR14:
+    m_square1.frequency =
+        static_cast<u16>((m_square1.frequency & 0xFF) | (_value & 0x7) << 8);
+    m_square1.length_enable = _value & 0x40;
+    if (_value & 0x80)
+      __trigger_square(m_square1, true);
+    break;
+
+  case 0xFF16: // NR21 duty, length
+    m_square2.duty = _value >> 6;
+    m_square2.length = 64 - (_value & 0x3F);
+    break;
+  case 0xFF17: // NR22 envelope
+    m_square2.env.load(_value);
+    m_square2.dac = _value & 0xF8;
+    m_square2.enabled &= m_square2.dac;
+    break;
+  case 0xFF18: // NR23 frequency low
+    m_square2.frequency = (m_square2.frequency & 0x700) | _value;
+    break;
+  case NR24:
+    m_square2.frequency =
+        static_cast<u16>((m_square2.frequency & 0xFF) | (_value & 0x7) << 8);
+    m_square2.length_enable = _value & 0x40;
+    if (_value & 0x80)
+      __trigger_square(m_square2, false);
+    break;
+
+  case NR30: // DAC power
+    m_wave.dac = _value & 0x80;
+    m_wave.enabled &= m_wave.dac;
+    break;
+  case 0xFF1B: // NR31 length
+    m_wave.length = 256 - _value;
+    break;
+  case 0xFF1C: // NR32 output level
+    m_wave.volume_code = (_value >> 5) & 0x3;
+    break;
+  case 0xFF1D: // NR33 frequency low
+    m_wave.frequency = (m_wave.frequency & 0x700) | _value;
+    break;
+  case NR34:
+    m_wave.frequency =
+        static_cast<u16>((m_wave.frequency & 0xFF) | (_value & 0x7) << 8);
+    m_wave.length_enable = _value & 0x40;
+    if (_value & 0x80)
+      __trigger_wave();
+    break;
+
+  case 0xFF20: // NR41 length
+    m_noise.length = 64 - (_value & 0x3F);
+    break;
+  case 0xFF21: // NR42 envelope
+    m_noise.env.load(_value);
+    m_noise.dac = _value & 0xF8;
+    m_noise.enabled &= m_noise.dac;
+    break;
+  case 0xFF22: // NR43 polynomial counter
+    m_noise.shift = _value >> 4;
+    m_noise.narrow = _value & 0x08;
+    m_noise.divisor = _value & 0x07;
+    break;
+  case NR44:
+    m_noise.length_enable = _value & 0x40;
+    if (_value & 0x80)
+      __trigger_noise();
+    break;
+  }
+  __refresh_levels();
+}
+
+auto apu::flush(u64 _clock) -> void { __run_until(_clock); }
+
+auto apu::save(state &_state) const -> void {
+  _state.regs = m_regs;
+  _state.power = m_power;
+  _state.square1 = m_square1;
+  _state.square2 = m_square2;
+  _state.sweep = m_sweep;
+  _state.wave_channel = m_wave;
+  _state.noise_channel = m_noise;
+  _state.now = m_now;
+  _state.next_step = m_next_step;
+  _state.step = m_step;
+}
+
+// the sample timeline moves with the clock, so the host hears the loaded
+// state straight after what it already has
+auto apu::load(const state &_state) -> void {
+  const u64 pending = m_synthesis ? m_now - m_base : m_pending;
+  m_regs = _state.regs;
+  m_power = _state.power;
+  m_square1 = _state.square1;
+  m_square2 = _state.square2;
+  m_sweep = _state.sweep;
+  m_wave = _state.wave_channel;
+  m_noise = _state.noise_channel;
+  m_now = _state.now;
+  m_next_step = _state.next_step;
+  m_step = _state.step;
+  m_pending = std::min(pending, m_now);
+  if (m_synthesis) {
+    m_base = m_now - m_pending;
+    __mix(m_now);
+  }
+}
+
+auto apu::set_synthesis(bool _on) -> void {
+  if (_on == m_synthesis)
+    return;
+  if (_on) {
+    // pick the sample timeline up where the host last heard it
+    m_base = m_now - std::min(m_pending, m_now);
+    m_synthesis = true;
+    __mix(m_now);
+  } else {
+    m_pending = m_now - m_base;
+    m_synthesis = false;
+  }
+}
+
+auto apu::__run_until(u64 _clock) -> void {
+  while (m_now < _clock) {
+    const u64 until = std::min(_clock, m_next_step);
+    __run_channels(until);
+    m_now = until;
+
+    if (m_now == m_next_step) {
+      __clock_sequencer();
+      m_next_step += SEQUENCER_PERIOD;
+    }
+    if (m_synthesis)
+      __emit(m_now);
+  }
+}
+
+auto apu::__run_channels(u64 _until) -> void {
+  __run_square(m_square1, _until);
+  __run_square(m_square2, _until);
+  __run_wave(_until);
+  __run_noise(_until);
+}
+
+// without synthesis only the final position and level matter, so the
+// channel jumps over its steps like a silent one
+auto apu::__run_square(square &_channel, u64 _until) -> void {
+  if (!_channel.enabled)
+    return;
+  if (_channel.env.volume == 0 || !m_synthesis) {
+    const u64 steps = __skip(_channel, _channel.period(), _until);
+    _channel.position = static_cast<u8>((_channel.position + steps) & 7);
+    if (steps)
+      __set_level(_channel, _until, _channel.output());
+    return;
+  }
+
+  u64 t = m_now;
+  while (t + _channel.timer <= _until) {
+    t += _channel.timer;
+    _channel.timer = _channel.period();
+    _channel.position = (_channel.position + 1) & 7;
+    __set_level(_channel, t, _channel.output());
+  }
+  _channel.timer -= static_cast<u32>(_until - t);
+}
+
+auto apu::__run_wave(u64 _until) -> void {
+  if (!m_wave.enabled)
+    return;
+  if (m_wave.volume_code == 0 || !m_synthesis) {
+    const u64 steps = __skip(m_wave, m_wave.period(), _until);
+    m_wave.position = static_cast<u8>((m_wave.position + steps) & 31);
+    if (steps)
+      __set_level(m_wave, _until, __wave_level());
+    return;
+  }
+
+  u64 t = m_now;
+  while (t + m_wave.timer <= _until) {
+    t += m_wave.timer;
+    m_wave.timer = m_wave.period();
+    m_wave.position = (m_wave.position + 1) & 31;
+    __set_level(m_wave, t, __wave_level());
+  }
+  m_wave.timer -= static_cast<u32>(_until - t);
+}
+
+// the LFSR sequence has to stay exact, so noise is stepped even when muted
+auto apu::__run_noise(u64 _until) -> void {
+  if (!m_noise.enabled)
+    return;
+
+  u64 t = m_now;
+  const u32 period = m_noise.period();
+  while (t + m_noise.timer <= _until) {
+    t += m_noise.timer;
+    m_noise.timer = period;
+
+    const u16 bit = (m_noise.lfsr ^ (m_noise.lfsr >> 1)) & 1;
+    m_noise.lfsr = static_cast<u16>((m_noise.lfsr >> 1) | (bit << 14));
+    if (m_noise.narrow)
+      m_noise.lfsr = static_cast<u16>((m_noise.lfsr & ~0x40) | (bit << 6));
+    __set_level(m_noise, t, __noise_level());
+  }
+  m_noise.timer -= static_cast<u32>(_until - t);
+}
+
+// jump a silent channel over every waveform step up to _until,
+// returns how many steps were taken
+auto apu::__skip(channel &_channel, u32 _period, u64 _until) -> u64 {
+  const u64 span = _until - m_now;
+  if (span < _channel.timer) {
+    _channel.timer -= static_cast<u32>(span);
+    return 0;
+  }
+  const u64 steps = 1 + (span - _channel.timer) / _period;
+  _channel.timer =
+      static_cast<u32>(_channel.timer + steps * _period - span);
+  return steps;
+}
+
+auto apu::__clock_sequencer() -> void {
+  if (!m_power) {
+    m_step = (m_step + 1) & 7;
+    return;
+  }
+
+  if ((m_step & 1) == 0) { // length counters on 0, 2, 4, 6
+    auto length = [](channel &_channel) {
+      if (_channel.length_enable && _channel.length > 0 &&
+          --_channel.length == 0)
+        _channel.enabled = false;
+    };
+    length(m_square1);
+    length(m_square2);
+    length(m_wave);
+    length(m_noise);
+  }
+
+  if (m_step == 2 || m_step == 6) {
+    if (m_sweep.timer > 0 && --m_sweep.timer == 0) {
+      m_sweep.timer = m_sweep.period ? m_sweep.period : 8;
+      if (m_sweep.enabled && m_sweep.period) {
+        const u16 frequency = __sweep_frequency();
+        if (frequency <= 2047 && m_sweep.shift) {
+          m_sweep.shadow = frequency;
+          m_square1.frequency = frequency;
+          __sweep_frequency();
+        }
+      }
+    }
+  }
+
+  if (m_step == 7) {
+    m_square1.env.clock();
+    m_square2.env.clock();
+    m_noise.env.clock();
+  }
+
+  m_step = (m_step + 1) & 7;
+  __refresh_levels();
+}
+
+auto apu::__emit(u64 _clock) -> void {
+  auto count = static_cast<u32>((_clock - m_base) / CYCLES_PER_SAMPLE);
+
+  while (count) {
+    u32 n;
+    if (m_resampler) {
+      n = std::min(count, audio_block::FRAMES);
+      m_buffers[0].read(n, m_native.data());
+      m_buffers[1].read(n, m_native.data() + 1);
+      const u32 frames =
+          m_resampler->process(m_native.data(), n, m_resampled.data(),
+                               static_cast<u32>(m_resampled.size() / 2));
+      __output(m_resampled.data(), frames);
+    } else {
+      // native rate: integrate straight into the ring slot
+      n = std::min(count, audio_block::FRAMES - m_block_frames);
+      float *out = __block();
+      m_buffers[0].read(n, out);
+      m_buffers[1].read(n, out + 1);
+      __commit(n);
+    }
+    m_base += static_cast<u64>(n) * CYCLES_PER_SAMPLE;
+    count -= n;
+  }
+}
+
+auto apu::__output(const float *_frames, u32 _count) -> void {
+  while (_count) {
+    const u32 n = std::min(_count, audio_block::FRAMES - m_block_frames);
+    std::copy(_frames, _frames + n * 2, __block());
+    __commit(n);
+    _frames += n * 2;
+    _count -= n;
+  }
+}
+
+// write position in the block being filled
+auto apu::__block() -> float * {
+  if (!m_block) {
+    m_block = blocks.write_slot();
+    m_dropping = !m_block;
+    if (m_dropping)
+      m_block = &m_overflow;
+  }
+  return m_block->samples.data() + m_block_frames * 2;
+}
+
+auto apu::__commit(u32 _frames) -> void {
+  m_block_frames += _frames;
+  if (m_block_frames < audio_block::FRAMES)
+    return;
+
+  // decimation: refill the same block in place until one is kept
+  if (m_decimate > 1) {
+    if (m_decimate_phase++ % m_decimate) {
+      m_block_frames = 0;
+      return;
+    }
+    __fade(*m_block);
+  }
+
+  if (tap) {
+    audio_block *copy;
+    while (!(copy = tap->write_slot()))
+      std::this_thread::yield();
+    *copy = *m_block;
+    tap->publish();
+  }
+
+  if (m_dropping)
+    ++dropped_blocks;
+  else
+    blocks.publish();
+  m_block = nullptr;
+  m_block_frames = 0;
+}
+
+// kept blocks are not contiguous, ramp both edges to avoid clicks
+auto apu::__fade(audio_block &_block) -> void {
+  float *head = _block.samples.data();
+  float *tail = head + (audio_block::FRAMES - 1) * 2;
+  for (u32 i = 0; i < DECIMATE_FADE; ++i) {
+    const float gain = static_cast<float>(i) / DECIMATE_FADE;
+    head[i * 2] *= gain;
+    head[i * 2 + 1] *= gain;
+    tail[-static_cast<int>(i) * 2] *= gain;
+    tail[-static_cast<int>(i) * 2 + 1] *= gain;
+  }
+}
+
+auto apu::set_decimation(u32 _factor) -> void {
+  m_decimate = std::max(_factor, 1u);
+  m_decimate_phase = 0;
+}
+
+auto apu::set_output_rate(u32 _rate) -> void {
+  if (_rate == 0 || _rate == SAMPLE_RATE) {
+    m_output_rate = SAMPLE_RATE;
+    m_resampler.reset();
+    return;
+  }
+
+  m_output_rate = _rate;
+  m_resampler.emplace(SAMPLE_RATE, _rate);
+  m_native.assign(audio_block::FRAMES * 2, 0.0f);
+  m_resampled.assign(m_resampler->max_output(audio_block::FRAMES) * 2, 0.0f);
+}
+
+auto apu::__set_level(channel &_channel, u64 _at, u8 _level) -> void {
+  if (_channel.level == _level)
+    return;
+  _channel.level = _level;
+  __mix(_at);
+}
+
+auto apu::__mix(u64 _at) -> void {
+  if (!m_synthesis)
+    return;
+
+  const u8 nr50 = m_regs[NR50 - NR10];
+  const u8 nr51 = m_regs[NR51 - NR10];
+  const std::array<const channel *, 4> channels = {&m_square1, &m_square2,
+                                                   &m_wave, &m_noise};
+
+  std::array<float, 2> amplitude{};
+  for (u32 i = 0; i < channels.size(); ++i) {
+    const auto level = static_cast<float>(channels[i]->level);
+    if (nr51 >> (i + 4) & 1)
+      amplitude[0] += level;
+    if (nr51 >> i & 1)
+      amplitude[1] += level;
+  }
+  amplitude[0] *= static_cast<float>(((nr50 >> 4) & 0x7) + 1);
+  amplitude[1] *= static_cast<float>((nr50 & 0x7) + 1);
+
+  for (u32 side = 0; side < 2; ++side) {
+    if (amplitude[side] != m_amplitude[side]) {
+      m_buffers[side].add_delta(_at - m_base,
+                                amplitude[side] - m_amplitude[side]);
+      m_amplitude[side] = amplitude[side];
+    }
+  }
+}
+
+auto apu::__wave_level() const -> u8 {
+  if (!m_wave.enabled || !m_wave.dac || m_wave.volume_code == 0)
+    return 0;
+  const u8 packed = m_regs[WAVE_RAM - NR10 + m_wave.position / 2];
+  const u8 sample = m_wave.position & 1 ? packed & 0xF : packed >> 4;
+  return sample >> (m_wave.volume_code - 1);
+}
+
+auto apu::__noise_level() const -> u8 {
+  if (!m_noise.enabled || !m_noise.dac)
+    return 0;
+  return m_noise.lfsr & 1 ? 0 : m_noise.env.volume;
+}
+
+auto apu::__refresh_levels() -> void {
+  __set_level(m_square1, m_now, m_square1.output());
+  __set_level(m_square2, m_now, m_square2.output());
+  __set_level(m_wave, m_now, __wave_level());
+  __set_level(m_noise, m_now, __noise_level());
+  __mix(m_now);
+}
+
+auto apu::__trigger_square(square &_channel, bool _sweep) -> void {
+  _channel.enabled = _channel.dac;
+  if (_channel.length == 0)
+    _channel.length = 64;
+  _channel.timer = _channel.period();
+  _channel.env.trigger();
+
+  if (_sweep) {
+    m_sweep.shadow = _channel.frequency;
+    m_sweep.timer = m_sweep.period ? m_sweep.period : 8;
+    m_sweep.enabled = m_sweep.period || m_sweep.shift;
+    if (m_sweep.shift)
+      __sweep_frequency();
+  }
+}
+
+auto apu::__trigger_wave() -> void {
+  m_wave.enabled = m_wave.dac;
+  if (m_wave.length == 0)
+    m_wave.length = 256;
+  m_wave.timer = m_wave.period();
+  m_wave.position = 0;
+}
+
+auto apu::__trigger_noise() -> void {
+  m_noise.enabled = m_noise.dac;
+  if (m_noise.length == 0)
+    m_noise.length = 64;
+  m_noise.timer = m_noise.period();
+  m_noise.lfsr = 0x7FFF;
+  m_noise.env.trigger();
+}
+
+// next sweep frequency, disables channel 1 on overflow
+auto apu::__sweep_frequency() -> u16 {
+  const u16 delta = m_sweep.shadow >> m_sweep.shift;
+  const u16 frequency = m_sweep.down ? m_sweep.shadow - delta
+                                     : m_sweep.shadow + delta;
+  if (frequency > 2047)
+    m_square1.enabled = false;
+  return frequency;
+}
+
+auto apu::__power_off() -> void {
+  std::fill(m_regs.begin(), m_regs.begin() + (NR52 - NR10), u8{0});
+  m_square1 = {};
+  m_square2 = {};
+  m_sweep = {};
+  m_wave = {};
+  m_noise = {};
+  m_power = false;
+  __mix(m_now);
+}
+
+} // namespace mpu
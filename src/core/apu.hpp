@@ -0,0 +1,286 @@
+#ifndef __CORE_APU_HPP
+#define __CORE_APU_HPP
+
+#include "common.hpp"
+#include "resampler.hpp"
+#include "ring.hpp"
+#include <array>
+#include <optional>
+#include <vector>
+
+namespace mpu {
+
+// one block of interleaved stereo samples handed to the host
+struct audio_block {
+  constexpr static u32 FRAMES = 512;
+  std::array<float, FRAMES * 2> samples;
+};
+
+/**
+ * Band-limited step buffer
+ * @brief accumulates amplitude changes as band-limited impulses at exact
+ * T-cycle positions; integrating the buffer yields band-limited steps.
+ */
+struct blip_buffer {
+  constexpr static u32 PHASES = 64; // one phase per T-cycle of a sample
+  constexpr static u32 WIDTH = 16;  // impulse taps
+  constexpr static u32 CAPACITY = audio_block::FRAMES * 2;
+
+  // add a step of _delta at _offset T-cycles from the first buffered sample
+  auto add_delta(u64 _offset, float _delta) -> void;
+
+  // integrate the first _count samples into _out (stride 2) and drop them
+  auto read(u32 _count, float *_out) -> void;
+
+private:
+  std::array<float, CAPACITY + WIDTH> m_deltas{};
+  float m_integral = 0.0f;
+  float m_dc = 0.0f;
+};
+
+/**
+ * Audio Processing Unit
+ * @brief four DMG sound channels behind NR10-NR52 and wave RAM.
+ *
+ * Nothing runs per instruction: the APU catches up to the bus clock only
+ * when a sound register is accessed or flush() is called, stepping each
+ * channel from one waveform edge to the next and recording edges into the
+ * BLEP buffers. Completed blocks go to the host through an SPSC ring.
+ *
+ * Blocks carry SAMPLE_RATE audio unless set_output_rate() asks for a host
+ * rate, in which case every block passes through the resampler first.
+ * Headless runs never set a rate and skip that stage entirely.
+ */
+struct apu {
+  constexpr static u32 CLOCK_RATE = 4'194'304;
+  constexpr static u32 CYCLES_PER_SAMPLE = blip_buffer::PHASES;
+  constexpr static u32 SAMPLE_RATE = CLOCK_RATE / CYCLES_PER_SAMPLE;
+  constexpr static u32 SEQUENCER_PERIOD = CLOCK_RATE / 512;
+
+  constexpr static u16 NR10 = 0xFF10;
+  constexpr static u16 NR14 = 0xFF14;
+  constexpr static u16 NR24 = 0xFF19;
+  constexpr static u16 NR30 = 0xFF1A;
+  constexpr static u16 NR34 = 0xFF1E;
+  constexpr static u16 NR44 = 0xFF23;
+  constexpr static u16 NR50 = 0xFF24;
+  constexpr static u16 NR51 = 0xFF25;
+  constexpr static u16 NR52 = 0xFF26;
+  constexpr static u16 WAVE_RAM = 0xFF30;
+
+  // host side of the sample stream
+  spsc_ring<audio_block, 8> blocks;
+  u64 dropped_blocks = 0; // blocks lost because the host fell behind
+
+  // second consumer (recorders): receives a copy of every completed block,
+  // whether or not the host took it; the APU waits while it is full
+  using tap_ring = spsc_ring<audio_block, 64>;
+  tap_ring *tap = nullptr;
+
+  auto read(u16 _addr, u64 _clock) -> u8;
+  auto write(u16 _addr, u8 _value, u64 _clock) -> void;
+
+  // synthesize up to _clock and publish every completed block
+  auto flush(u64 _clock) -> void;
+
+  // synthesis switch: when off the channels still advance exactly (the
+  // machine state does not depend on it) but no samples are produced
+  auto set_synthesis(bool _on) -> void;
+  auto synthesis() const -> bool { return m_synthesis; }
+
+  // resample blocks to _rate Hz, 0 or SAMPLE_RATE publishes native blocks
+  auto set_output_rate(u32 _rate) -> void;
+  auto output_rate() const -> u32 { return m_output_rate; }
+
+  // fast-forward decimation: publish one block in _factor, faded at both
+  // ends, so sped-up audio keeps its pitch and real-time length at the cost
+  // of skipping the audio in between (not an overlap-add stretch); 1 is off
+  auto set_decimation(u32 _factor) -> void;
+  auto decimation() const -> u32 { return m_decimate; }
+
+  // channel and sequencer state for snapshots; the host side (synthesis
+  // switch, sample timeline and buffers, block ring, output stage) is not
+  // part of it and carries on across a load
+  struct state;
+  auto save(state &_state) const -> void;
+  auto load(const state &_state) -> void;
+
+private:
+  struct envelope {
+    u8 initial = 0;
+    bool up = false;
+    u8 period = 0;
+    u8 timer = 0;
+    u8 volume = 0;
+
+    auto load(u8 _nrx2) -> void;
+    auto trigger() -> void;
+    auto clock() -> void;
+
+    // members in encoding order, see state_io.hpp
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.initial, _s.up, _s.period, _s.timer, _s.volume);
+    }
+  };
+
+  struct channel {
+    bool enabled = false;
+    bool dac = false;
+    bool length_enable = false;
+    u16 length = 0;
+    u16 frequency = 0;
+    u32 timer = 0; // T-cycles until the next waveform step
+    u8 level = 0;  // current DAC input, 0-15
+
+    // members in encoding order, see state_io.hpp; the channel types
+    // below pass theirs after these
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.enabled, _s.dac, _s.length_enable, _s.length, _s.frequency,
+         _s.timer, _s.level);
+    }
+  };
+
+  struct square : channel {
+    u8 duty = 0;
+    u8 position = 0;
+    envelope env;
+    auto period() const -> u32 { return (2048u - frequency) * 4; }
+    auto output() const -> u8;
+
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      channel::fields(_s, [&](auto &..._base) {
+        _f(_base..., _s.duty, _s.position, _s.env);
+      });
+    }
+  };
+
+  struct sweep_unit {
+    u8 period = 0;
+    bool down = false;
+    u8 shift = 0;
+    u8 timer = 0;
+    bool enabled = false;
+    u16 shadow = 0;
+
+    // members in encoding order, see state_io.hpp
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.period, _s.down, _s.shift, _s.timer, _s.enabled, _s.shadow);
+    }
+  };
+
+  struct wave : channel {
+    u8 volume_code = 0;
+    u8 position = 0;
+    auto period() const -> u32 { return (2048u - frequency) * 2; }
+
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      channel::fields(_s, [&](auto &..._base) {
+        _f(_base..., _s.volume_code, _s.position);
+      });
+    }
+  };
+
+  struct noise : channel {
+    u8 shift = 0;
+    bool narrow = false;
+    u8 divisor = 0;
+    u16 lfsr = 0x7FFF;
+    envelope env;
+    auto period() const -> u32 {
+      return (divisor ? divisor * 16u : 8u) << shift;
+    }
+
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      channel::fields(_s, [&](auto &..._base) {
+        _f(_base..., _s.shift, _s.narrow, _s.divisor, _s.lfsr, _s.env);
+      });
+    }
+  };
+
+  std::array<u8, 0x30> m_regs{}; // raw NR10-wave RAM backing store
+  bool m_power = false;
+  bool m_synthesis = true;
+  square m_square1;
+  square m_square2;
+  sweep_unit m_sweep;
+  wave m_wave;
+  noise m_noise;
+
+  u64 m_now = 0;                              // clock synthesized up to
+  u64 m_next_step = SEQUENCER_PERIOD;         // next frame sequencer step
+  u8 m_step = 0;                              // frame sequencer position
+  u64 m_base = 0;                             // clock of buffered sample 0
+  u64 m_pending = 0; // m_now - m_base when synthesis last stopped
+  std::array<float, 2> m_amplitude{};         // last mixed left/right level
+  std::array<blip_buffer, 2> m_buffers;       // left, right
+
+  // block being filled: a ring slot, or scratch while the host is behind
+  audio_block *m_block = nullptr;
+  u32 m_block_frames = 0;
+  bool m_dropping = false;
+  audio_block m_overflow;
+
+  // host rate output stage, absent when publishing native blocks
+  u32 m_output_rate = SAMPLE_RATE;
+  std::optional<resampler> m_resampler;
+  std::vector<float> m_native;
+  std::vector<float> m_resampled;
+
+  u32 m_decimate = 1;
+  u32 m_decimate_phase = 0; // completed blocks since the last kept one
+
+  auto __run_until(u64 _clock) -> void;
+  auto __run_channels(u64 _until) -> void;
+  auto __run_square(square &_channel, u64 _until) -> void;
+  auto __run_wave(u64 _until) -> void;
+  auto __run_noise(u64 _until) -> void;
+  auto __skip(channel &_channel, u32 _period, u64 _until) -> u64;
+  auto __clock_sequencer() -> void;
+  auto __emit(u64 _clock) -> void;
+  auto __output(const float *_frames, u32 _count) -> void;
+  auto __block() -> float *;
+  auto __commit(u32 _frames) -> void;
+  auto __fade(audio_block &_block) -> void;
+
+  auto __set_level(channel &_channel, u64 _at, u8 _level) -> void;
+  auto __mix(u64 _at) -> void;
+  auto __refresh_levels() -> void;
+  auto __wave_level() const -> u8;
+  auto __noise_level() const -> u8;
+
+  auto __trigger_square(square &_channel, bool _sweep) -> void;
+  auto __trigger_wave() -> void;
+  auto __trigger_noise() -> void;
+  auto __sweep_frequency() -> u16;
+  auto __power_off() -> void;
+};
+
+struct apu::state {
+  std::array<u8, 0x30> regs;
+  bool power;
+  square square1;
+  square square2;
+  sweep_unit sweep;
+  wave wave_channel;
+  noise noise_channel;
+  u64 now;
+  u64 next_step;
+  u8 step;
+
+  // members in encoding order, see state_io.hpp
+  template <typename S, typename F>
+  static auto fields(S &_s, F &&_f) -> void {
+    _f(_s.regs, _s.power, _s.square1, _s.square2, _s.sweep, _s.wave_channel,
+       _s.noise_channel, _s.now, _s.next_step, _s.step);
+  }
+};
+
+} // namespace mpu
+
+#endif
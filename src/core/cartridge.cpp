@@ -0,0 +1,267 @@
+#include "cartridge.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <string>
+
+namespace mpu {
+
+namespace {
+struct header_type {
+  cartridge::mbc kind;
+  bool battery;
+  bool timer = false;
+};
+
+// cartridge type byte at 0x0147
+auto decode_type(u8 _type) -> header_type {
+  using mbc = cartridge::mbc;
+  switch (_type) {
+  case 0x00: // ROM only
+  case 0x08: // ROM+RAM
+    return {mbc::none, false};
+  case 0x09: // ROM+RAM+BATTERY
+    return {mbc::none, true};
+  case 0x01:
+  case 0x02:
+    return {mbc::mbc1, false};
+  case 0x03:
+    return {mbc::mbc1, true};
+  case 0x11:
+  case 0x12:
+    return {mbc::mbc3, false};
+  case 0x0F: // +TIMER+BATTERY
+  case 0x10: // +TIMER+RAM+BATTERY
+    return {mbc::mbc3, true, true};
+  case 0x13:
+    return {mbc::mbc3, true};
+  case 0x19:
+  case 0x1A:
+  case 0x1C: // +RUMBLE
+  case 0x1D:
+    return {mbc::mbc5, false};
+  case 0x1B:
+  case 0x1E:
+    return {mbc::mbc5, true};
+  default:
+    throw mpu_runtime_error("unsupported cartridge type " +
+                            std::to_string(_type));
+  }
+}
+
+// RAM size byte at 0x0149
+auto decode_ram_size(u8 _code) -> std::size_t {
+  switch (_code) {
+  case 0x00:
+    return 0;
+  case 0x01:
+    return 0x800;
+  case 0x02:
+    return 0x2000;
+  case 0x03:
+    return 0x8000;
+  case 0x04:
+    return 0x20000;
+  case 0x05:
+    return 0x10000;
+  default:
+    throw mpu_runtime_error("unsupported cartridge RAM size code " +
+                            std::to_string(_code));
+  }
+}
+
+auto put_u32(u8 *_to, u32 _value) -> void {
+  for (int i = 0; i < 4; ++i)
+    _to[i] = static_cast<u8>(_value >> (8 * i));
+}
+
+auto get_u32(const u8 *_from) -> u32 {
+  u32 value = 0;
+  for (int i = 0; i < 4; ++i)
+    value |= static_cast<u32>(_from[i]) << (8 * i);
+  return value;
+}
+
+auto unix_time() -> u64 {
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count());
+}
+} // namespace
+
+cartridge::cartridge() : m_rom(2 * ROM_BANK) {}
+
+auto cartridge::load(std::span<const u8> _image) -> void {
+  const u8 type = _image.size() > TYPE ? _image[TYPE] : 0;
+  const u8 ram_code = _image.size() > RAM_SIZE ? _image[RAM_SIZE] : 0;
+  const auto [kind, battery, timer] = decode_type(type);
+  const std::size_t ram_size = decode_ram_size(ram_code);
+
+  // the image itself decides the size; the bank mask needs a power of two
+  m_rom_banks = std::bit_ceil(std::max<std::size_t>(
+      2, (_image.size() + ROM_BANK - 1) / ROM_BANK));
+  m_rom.assign(m_rom_banks * ROM_BANK, 0);
+  std::copy(_image.begin(), _image.end(), m_rom.begin());
+
+  m_type = kind;
+  m_has_rtc = timer;
+  m_battery = battery && (ram_size || timer);
+  m_rtc = {};
+  m_save.reset();
+  m_scratch = false;
+  m_memory.assign(ram_size, 0);
+  m_ram = m_memory.data();
+  m_ram_size = ram_size;
+
+  m_rom_bank = 1;
+  m_ram_bank = 0;
+  m_mode = 0;
+  m_ram_enabled = kind == mbc::none; // no enable register to write
+  __remap();
+}
+
+auto cartridge::attach_save(const std::string &_path, bool _catch_up)
+    -> bool {
+  if (!m_battery)
+    return false;
+  m_save = std::make_unique<save_file>(
+      _path, m_ram_size + (m_has_rtc ? RTC_FOOTER : 0));
+  m_ram = m_save->data();
+  m_scratch = false;
+  m_memory.clear();
+  m_memory.shrink_to_fit();
+  if (!m_has_rtc)
+    return true;
+
+  // a zero timestamp is a file without a footer yet; the game has not run,
+  // so the counter is set from bus clock 0
+  const u8 *footer = m_save->data() + m_ram_size;
+  const u64 saved = get_u32(footer + 40) |
+                    static_cast<u64>(get_u32(footer + 44)) << 32;
+  if (!saved)
+    return true;
+  m_rtc = {};
+  m_rtc.write(rtc::DH, static_cast<u8>(get_u32(footer + 16)), 0);
+  for (u8 reg = rtc::S; reg < rtc::DH; ++reg)
+    m_rtc.write(reg, static_cast<u8>(get_u32(footer + 4 * (reg - rtc::S))), 0);
+  for (std::size_t i = 0; i < m_rtc.latched.size(); ++i)
+    m_rtc.latched[i] = static_cast<u8>(get_u32(footer + 20 + 4 * i));
+
+  const u64 now = unix_time();
+  if (_catch_up && now > saved)
+    m_rtc.advance(now - saved);
+  return true;
+}
+
+auto cartridge::persist(u64 _clock) -> void {
+  if (!m_save || !m_has_rtc || m_scratch)
+    return;
+  u8 *footer = m_save->data() + m_ram_size;
+  const auto current = m_rtc.registers(_clock);
+  for (std::size_t i = 0; i < current.size(); ++i) {
+    put_u32(footer + 4 * i, current[i]);
+    put_u32(footer + 20 + 4 * i, m_rtc.latched[i]);
+  }
+  const u64 now = unix_time();
+  put_u32(footer + 40, static_cast<u32>(now));
+  put_u32(footer + 44, static_cast<u32>(now >> 32));
+}
+
+// the copy keeps its allocation, run-ahead switches every frame
+auto cartridge::set_scratch(bool _on) -> void {
+  if (!m_save || _on == m_scratch)
+    return;
+  m_scratch = _on;
+  if (_on) {
+    m_memory.assign(m_ram, m_ram + m_ram_size);
+    m_ram = m_memory.data();
+  } else {
+    m_ram = m_save->data();
+  }
+}
+
+auto cartridge::write_control(u16 _addr, u8 _value, u64 _clock) -> void {
+  switch (m_type) {
+  case mbc::none:
+    return;
+
+  case mbc::mbc1:
+    if (_addr < 0x2000)
+      m_ram_enabled = (_value & 0x0F) == 0x0A;
+    else if (_addr < 0x4000)
+      m_rom_bank = std::max<u16>(_value & 0x1F, 1);
+    else if (_addr < 0x6000)
+      m_ram_bank = _value & 0x03; // also ROM bank bits 5-6
+    else
+      m_mode = _value & 0x01;
+    break;
+
+  case mbc::mbc3:
+    if (_addr < 0x2000)
+      m_ram_enabled = (_value & 0x0F) == 0x0A;
+    else if (_addr < 0x4000)
+      m_rom_bank = std::max<u16>(_value & 0x7F, 1);
+    else if (_addr < 0x6000)
+      m_ram_bank = _value & 0x0F;
+    else if (m_has_rtc) {
+      m_rtc.latch(_value, _clock);
+      persist(_clock);
+    }
+    break;
+
+  case mbc::mbc5:
+    if (_addr < 0x2000)
+      m_ram_enabled = (_value & 0x0F) == 0x0A;
+    else if (_addr < 0x3000)
+      m_rom_bank = static_cast<u16>((m_rom_bank & 0x100) | _value);
+    else if (_addr < 0x4000)
+      m_rom_bank = static_cast<u16>((m_rom_bank & 0xFF) | (_value & 0x01) << 8);
+    else if (_addr < 0x6000)
+      m_ram_bank = _value & 0x0F;
+    break;
+  }
+  __remap();
+}
+
+auto cartridge::save(state &_state) const -> void {
+  _state.rom_bank = m_rom_bank;
+  _state.ram_bank = m_ram_bank;
+  _state.mode = m_mode;
+  _state.ram_enabled = m_ram_enabled;
+  _state.timer = m_rtc;
+}
+
+auto cartridge::load(const state &_state) -> void {
+  m_rom_bank = _state.rom_bank;
+  m_ram_bank = _state.ram_bank;
+  m_mode = _state.mode;
+  m_ram_enabled = _state.ram_enabled;
+  m_rtc = _state.timer;
+  __remap();
+}
+
+// translate the bank registers into window offsets, wrapping at the ROM
+// and RAM sizes the way unconnected address lines do
+auto cartridge::__remap() -> void {
+  std::size_t bank0 = 0;
+  std::size_t bankn = m_rom_bank;
+  std::size_t ram_bank = m_ram_bank;
+  if (m_type == mbc::mbc1) {
+    bankn |= static_cast<std::size_t>(m_ram_bank) << 5;
+    if (m_mode)
+      bank0 = static_cast<std::size_t>(m_ram_bank) << 5;
+    else
+      ram_bank = 0;
+  }
+  m_rom0_offset = (bank0 & (m_rom_banks - 1)) * ROM_BANK;
+  m_romn_offset = (bankn & (m_rom_banks - 1)) * ROM_BANK;
+  m_ram_offset = ram_bank * RAM_BANK;
+  m_rtc_selected = m_has_rtc && m_ram_bank >= rtc::S && m_ram_bank <= rtc::DH;
+}
+
+auto cartridge::__write_rtc(u8 _value, u64 _clock) -> void {
+  m_rtc.write(m_ram_bank, _value, _clock);
+  persist(_clock);
+}
+
+} // namespace mpu
@@ -0,0 +1,158 @@
+#ifndef __CORE_CARTRIDGE_HPP
+#define __CORE_CARTRIDGE_HPP
+
+#include "common.hpp"
+#include "rtc.hpp"
+#include "save_file.hpp"
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Cartridge
+ * @brief ROM image, memory bank controller and external RAM.
+ *
+ * Supports plain 32 KiB carts (optionally with RAM), MBC1, MBC3 and MBC5.
+ * Bank switches only recompute offsets, so the 0x0000-7FFF and
+ * 0xA000-BFFF windows stay one indexed load each. Battery-backed RAM can
+ * be mapped straight onto the game's .sav file (attach_save), otherwise it
+ * lives in memory and is lost on exit.
+ *
+ * MBC3 timer carts carry an rtc; its registers are stored in the common
+ * 48-byte footer after the RAM in the .sav (five current and five latched
+ * registers as u32, then a u64 UNIX time), rewritten on every latch.
+ */
+struct cartridge {
+  enum class mbc : u8 { none, mbc1, mbc3, mbc5 };
+
+  constexpr static std::size_t ROM_BANK = 0x4000;
+  constexpr static std::size_t RAM_BANK = 0x2000;
+  constexpr static std::size_t MAX_RAM = 0x20000; // MBC5, 16 banks
+  constexpr static std::size_t RTC_FOOTER = 48;
+
+  // header fields
+  constexpr static u16 TYPE = 0x0147;
+  constexpr static u16 ROM_SIZE = 0x0148;
+  constexpr static u16 RAM_SIZE = 0x0149;
+
+  // blank 32 KiB ROM without RAM
+  cartridge();
+
+  cartridge(const cartridge &) = delete;
+  cartridge &operator=(const cartridge &) = delete;
+
+  // copy _image in and set up the controller its header asks for; RAM
+  // starts cleared and detached from any save file
+  auto load(std::span<const u8> _image) -> void;
+
+  // map the RAM onto _path, keeping what the file already holds; false
+  // (and nothing mapped) when the cart has no battery. With _catch_up the
+  // clock also moves on by the host time since the save was last written.
+  auto attach_save(const std::string &_path, bool _catch_up = true) -> bool;
+
+  // write the clock footer as of bus clock _clock, if there is one
+  auto persist(u64 _clock) -> void;
+
+  // while on, an attached save file is left alone: RAM writes land in a
+  // copy and the clock footer is not rewritten. Turning it off maps the
+  // file back and drops whatever the copy collected. For frames that are
+  // rolled back, see run_ahead.
+  auto set_scratch(bool _on) -> void;
+  auto scratch() const -> bool { return m_scratch; }
+
+  auto type() const -> mbc { return m_type; }
+  auto battery() const -> bool { return m_battery; }
+  auto has_rtc() const -> bool { return m_has_rtc; }
+  // RAM is mapped onto a save file (attach_save)
+  auto save_attached() const -> bool { return m_save != nullptr; }
+  auto rom() const -> std::span<const u8> { return m_rom; }
+  auto ram() -> std::span<u8> { return {m_ram, m_ram_size}; }
+  auto ram() const -> std::span<const u8> { return {m_ram, m_ram_size}; }
+
+  // 0x0000-7FFF
+  auto read_rom(u16 _addr) const -> u8 {
+    return _addr < ROM_BANK ? m_rom[m_rom0_offset + _addr]
+                            : m_rom[m_romn_offset + _addr - ROM_BANK];
+  }
+
+  // bank behind _addr in 0x0000-7FFF, for traces and profiles
+  auto rom_bank(u16 _addr) const -> u16 {
+    return static_cast<u16>(
+        (_addr < ROM_BANK ? m_rom0_offset : m_romn_offset) / ROM_BANK);
+  }
+
+  // 0xA000-BFFF, open bus while disabled or absent; MBC3 may have an RTC
+  // register mapped there instead
+  auto read_ram(u16 _addr) const -> u8 {
+    if (!m_ram_enabled)
+      return 0xFF;
+    if (m_rtc_selected)
+      return m_rtc.read(m_ram_bank);
+    if (!m_ram_size)
+      return 0xFF;
+    return m_ram[(m_ram_offset + _addr - 0xA000) & (m_ram_size - 1)];
+  }
+  auto write_ram(u16 _addr, u8 _value, u64 _clock) -> void {
+    if (!m_ram_enabled)
+      return;
+    if (m_rtc_selected)
+      __write_rtc(_value, _clock);
+    else if (m_ram_size)
+      m_ram[(m_ram_offset + _addr - 0xA000) & (m_ram_size - 1)] = _value;
+  }
+
+  // 0x0000-7FFF writes: controller registers
+  auto write_control(u16 _addr, u8 _value, u64 _clock) -> void;
+
+  // controller registers for snapshots; RAM contents are saved by the bus
+  struct state {
+    u16 rom_bank;
+    u8 ram_bank;
+    u8 mode;
+    bool ram_enabled;
+    rtc timer;
+
+    // members in encoding order, see state_io.hpp
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.rom_bank, _s.ram_bank, _s.mode, _s.ram_enabled, _s.timer);
+    }
+  };
+  auto save(state &_state) const -> void;
+  auto load(const state &_state) -> void;
+
+private:
+  std::vector<u8> m_rom;
+  std::size_t m_rom_banks = 2; // power of two
+  mbc m_type = mbc::none;
+  bool m_battery = false;
+  bool m_has_rtc = false;
+
+  u16 m_rom_bank = 1;
+  u8 m_ram_bank = 0;
+  u8 m_mode = 0; // MBC1 banking mode
+  bool m_ram_enabled = false;
+  bool m_rtc_selected = false; // MBC3 RAM bank 0x08-0x0C
+  rtc m_rtc;
+
+  std::size_t m_rom0_offset = 0;
+  std::size_t m_romn_offset = ROM_BANK;
+  std::size_t m_ram_offset = 0;
+
+  u8 *m_ram = nullptr;   // m_memory or the save file mapping
+  std::size_t m_ram_size = 0; // power of two
+  std::vector<u8> m_memory;
+  std::unique_ptr<save_file> m_save;
+  bool m_scratch = false; // m_ram is m_memory while a save is attached
+
+  auto __remap() -> void;
+  auto __write_rtc(u8 _value, u64 _clock) -> void;
+};
+
+} // namespace mpu
+
+#endif
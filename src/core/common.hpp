@@ -1,13 +1,16 @@
 #ifndef __CORE_COMMON_HPP
 #define __CORE_COMMON_HPP
 
+#include <chrono>
 #include <format>
 #include <stdexcept>
 
 namespace mpu {
+using clk = std::chrono::steady_clock;
 using u8 = unsigned char;
 using u16 = unsigned short;
 using u32 = unsigned int;
+using u64 = unsigned long long;
 
 struct mpu_runtime_error : std::runtime_error {
   mpu_runtime_error(std::string &&message);
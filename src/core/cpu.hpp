@@ -3,12 +3,16 @@
 
 #include "common.hpp"
 #include "memory.hpp"
+#include "pacer.hpp"
+#include "profile.hpp"
+#include "sampler.hpp"
+#include "trace.hpp"
+#include <algorithm>
 #include <array>
-#include <chrono>
+#include <csignal>
 #include <iostream>
 
 namespace mpu {
-using clk = std::chrono::steady_clock;
 
 struct CPU {
   // MPU timers addresses
@@ -22,6 +26,10 @@ private:
    * Z B HC C 0 0 0 0
    */
 
+  // register pairs start at the values the DMG boot ROM leaves behind,
+  // whether the CPU is default- or value-initialised; the first register
+  // of a pair is the low byte
+
   // Program Status Word (PSW)
   union p_PSW {
     u16 PSW;
@@ -29,6 +37,7 @@ private:
       u8 A;
       u8 F;
     };
+    p_PSW() : PSW(0xB001) {} // A = 0x01, F = 0xB0
   } PSW;
   // BC register pair
   union p_BC {
@@ -37,6 +46,7 @@ private:
       u8 B;
       u8 C;
     };
+    p_BC() : BC(0x1300) {} // B = 0x00, C = 0x13
   } BC;
   // DE register pair
   union p_DE {
@@ -45,6 +55,7 @@ private:
       u8 D;
       u8 E;
     };
+    p_DE() : DE(0xD800) {} // D = 0x00, E = 0xD8
   } DE;
   // HL register pair
   union p_HL {
@@ -53,6 +64,7 @@ private:
       u8 H;
       u8 L;
     };
+    p_HL() : HL(0x4D01) {} // H = 0x01, L = 0x4D
   } HL;
 
   // SP register
@@ -62,7 +74,7 @@ private:
   } SP;
 
 public:
-  p_PSW get_psw() { return PSW; }
+  p_PSW get_psw() const { return PSW; }
   void set_acc(const u8 _acc) { PSW.A = _acc; }
   void set_flags(const u8 _flags) { PSW.F = _flags; }
 
@@ -88,37 +100,233 @@ public:
   constexpr static u8 SUBTRACT_FLAG = 0x40;
   constexpr static u8 HALF_FLAG = 0x20;
   constexpr static u8 CARRY_FLAG = 0x10;
-  inline static bool INTERRUPT_ENABLE = false;
+  bool INTERRUPT_ENABLE = false; // IME
+
+  // T-cycle cost of each unprefixed opcode (instructions.cpp)
+  static const std::array<u8, 0x100> OPCODE_CYCLES;
+  static const std::array<u8, 0x100> BRANCH_CYCLES;
+
+  // run in real time, one paced frame after another, until _stop is set
+  // (by a signal handler, say)
+  void run(const volatile std::sig_atomic_t &_stop) {
+    pacer pace;
+    while (!_stop) {
+      run_frame();
+      pace.wait();
+    }
+  }
 
-  void run() {
-    while (true) {
-      __cycle();
+  // fetch, decode and execute the instruction at pc, then advance the bus
+  // clock by its cost; pending interrupts are serviced first when enabled.
+  // A halted core jumps straight to the next peripheral event instead, but
+  // no further than _limit (the caller's target clock).
+  void step(const u64 _limit = ~u64{0}) {
+    if (bus.clock >= sampler.due()) [[unlikely]]
+      __sample();
+    if (m_halted) {
+      if (!(bus.interrupt_enable & bus.io_regs[mmu::IF - 0xFF00] & 0x1F)) {
+        bus.tick(__halt_cycles(_limit));
+        return;
+      }
+      m_halted = false;
     }
+
+    if (INTERRUPT_ENABLE &&
+        (bus.interrupt_enable & bus.io_regs[mmu::IF - 0xFF00] & 0x1F)) {
+      __service_interrupt();
+      return;
+    }
+
+    const u16 from = pc;
+    const u8 opcode = __fetch_next();
+#ifdef GBOY_TRACE
+    if (m_recording)
+      __trace(from, opcode);
+#endif
+#ifdef GBOY_PROFILE
+    const u8 prefixed = opcode == 0xCB ? bus.at(pc) : 0;
+#endif
+    execute_instruction(opcode);
+    const u32 cycles = instruction_cycles(opcode, from, pc);
+#ifdef GBOY_PROFILE
+    if (m_recording)
+      profile.record(opcode, prefixed, cycles);
+#endif
+    bus.tick(cycles);
+  }
+
+  // T-cycles of _opcode at _from, given it left pc at _to
+  static auto instruction_cycles(u8 _opcode, u16 _from, u16 _to) -> u32 {
+    u32 cycles = OPCODE_CYCLES[_opcode];
+    if (BRANCH_CYCLES[_opcode] && _to != __fallthrough(_from, _opcode))
+      cycles += BRANCH_CYCLES[_opcode];
+    return cycles;
+  }
+
+  // step until the bus clock reaches _clock
+  void run_until(const u64 _clock) {
+    while (bus.clock < _clock) {
+      step(_clock);
+    }
+  }
+
+  // step until the PPU enters VBlank, or for one frame's worth of cycles
+  // while the LCD is off
+  void run_frame() {
+    const u64 frame = bus.video.frames;
+    const u64 limit = bus.clock + ppu::FRAME_CYCLES;
+    while (bus.video.frames == frame && bus.clock < limit) {
+      step(limit);
+    }
+  }
+
+  // register file and bus state, for in-memory save and restore
+  struct snapshot {
+    u16 af, bc, de, hl, sp, pc;
+    bool ime;
+    bool ready;
+    bool halted;
+    mmu::state bus;
+
+    // members in encoding order, see state_io.hpp
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.af, _s.bc, _s.de, _s.hl, _s.sp, _s.pc, _s.ime, _s.ready, _s.halted,
+       _s.bus);
+    }
+  };
+
+  void save(snapshot &_snapshot) const {
+    _snapshot.af = PSW.PSW;
+    _snapshot.bc = BC.BC;
+    _snapshot.de = DE.DE;
+    _snapshot.hl = HL.HL;
+    _snapshot.sp = SP.SP;
+    _snapshot.pc = pc;
+    _snapshot.ime = INTERRUPT_ENABLE;
+    _snapshot.ready = m_ready;
+    _snapshot.halted = m_halted;
+    bus.save(_snapshot.bus);
+  }
+
+  void load(const snapshot &_snapshot) {
+    PSW.PSW = _snapshot.af;
+    BC.BC = _snapshot.bc;
+    DE.DE = _snapshot.de;
+    HL.HL = _snapshot.hl;
+    SP.SP = _snapshot.sp;
+    pc = _snapshot.pc;
+    INTERRUPT_ENABLE = _snapshot.ime;
+    m_ready = _snapshot.ready;
+    m_halted = _snapshot.halted;
+    bus.load(_snapshot.bus);
+    // the clock may have jumped either way; sample from the new one on
+    if (sampler.running())
+      sampler.start(sampler.interval(), bus.clock);
   }
 
   auto execute_instruction(u8) -> void;
 
+#ifdef GBOY_TRACE
+  // last instructions executed by step(), see gboy-trace
+  trace_ring trace;
+#endif
+#ifdef GBOY_PROFILE
+  // opcode counts and cycles of step(), see gboy --profile
+  opcode_profile profile;
+#endif
+  // where step() spends guest time once started, see gboy-pcprof
+  pc_sampler sampler;
+
+  // off while running frames that are rolled back afterwards (run_ahead),
+  // so the trace, profile and PC samples only cover frames that count; a
+  // running sampler resumes at the sample it was due to take
+  void set_recording(const bool _on) {
+    if (_on == m_recording)
+      return;
+    m_recording = _on;
+    if (!_on) {
+      m_paused_due = sampler.due();
+      sampler.stop();
+    } else if (m_paused_due != pc_sampler::NEVER) {
+      sampler.start(sampler.interval(), m_paused_due);
+    }
+  }
+  bool recording() const { return m_recording; }
+
 private:
-  u16 pc;                        // program counter
+  u16 pc = 0x0100;               // program counter (cartridge entry)
   mmu bus;                       // 16b memory bus (64KiB)
   bool m_ready = true;           // mpu ready state
-  const u32 m_speed = 3'000'000; // 3 MHz clock speed
+  bool m_halted = false;         // HALT, waiting for IE & IF
+  bool m_recording = true;       // see set_recording
+  u64 m_paused_due = pc_sampler::NEVER; // sampler due while not recording
 
-  auto __cycle() -> void {
-    for (u32 i = 0; i < m_speed; ++i) {
-      if (m_ready) {
-        u8 opcode = bus.at(pc);
-        execute_instruction(opcode);
-      }
+  auto __fetch_next() -> u8 { return bus.at(pc++); }
+
+  // M-cycle aligned distance to the next bus event, at most one frame so
+  // a halt with the LCD off still returns to run_frame() regularly, and
+  // never past _limit, so run_until() slices (link_cable) stay bounded
+  auto __halt_cycles(u64 _limit) const -> u32 {
+    const u64 until = std::min(
+        {bus.next_event(), bus.clock + ppu::FRAME_CYCLES, _limit});
+    const u64 cycles = until > bus.clock ? until - bus.clock : 4;
+    return static_cast<u32>((cycles + 3) & ~u64{3});
+  }
+  auto __service_interrupt() -> void;
+
+  auto __sample() -> void {
+    sampler.record(pc < 0x8000 ? bus.cart.rom_bank(pc) : 0, pc, bus.clock);
+  }
+
+#ifdef GBOY_TRACE
+  // fields go straight into the slot; packing them in a local first made
+  // GCC spill every byte. ROM operands are left to the decoder.
+  auto __trace(u16 _from, u8 _opcode) -> void {
+    trace_record &record = trace.next();
+    record.clock = bus.clock;
+    record.pc = _from;
+    record.bank = _from < 0x8000 ? bus.cart.rom_bank(_from) : 0;
+    record.sp = SP.SP;
+    record.opcode = _opcode;
+    record.ime = INTERRUPT_ENABLE;
+    record.af = PSW.PSW;
+    record.bc = BC.BC;
+    record.de = DE.DE;
+    record.hl = HL.HL;
+    if (_from >= 0x8000) [[unlikely]] {
+      record.operands[0] = bus.at(pc);
+      record.operands[1] = bus.at(static_cast<u16>(pc + 1));
+    } else {
+      record.operands[0] = record.operands[1] = 0;
     }
-    TODO("render onto screen and update cycles");
   }
-  auto __fetch_next() -> u8 { return bus.at(pc++); }
+#endif
+
+  // address following a conditional JR (2), RET (1), JP or CALL (3)
+  static auto __fallthrough(u16 _from, u8 _opcode) -> u16 {
+    if (_opcode < 0x40)
+      return _from + 2;
+    return (_opcode & 0x7) == 0 ? _from + 1 : _from + 3;
+  }
 
 public:
+  // HALT: stop fetching until an enabled interrupt is requested
+  void halt() { m_halted = true; }
+  bool halted() const { return m_halted; }
+
   // getter and setter for program counter
   u16 get_pc() const { return pc; }
   void set_pc(const u16 _pc) { pc = _pc; }
+
+  // headless switches: skip audio synthesis or pixel generation while
+  // registers, timing and interrupts behave exactly the same
+  void set_audio_enabled(const bool _on) { bus.sound.set_synthesis(_on); }
+  void set_video_enabled(const bool _on) { bus.video.render = _on; }
+
+  // memory bus attached to this cpu
+  mmu &get_bus() { return bus; }
+  const mmu &get_bus() const { return bus; }
 };
 }; // namespace mpu
 
@@ -0,0 +1,58 @@
+#include "fast_forward.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace mpu {
+
+fast_forward::fast_forward(CPU &_cpu, u32 _render_every, audio_mode _audio)
+    : m_cpu(_cpu), m_render_every(std::max(_render_every, 1u)),
+      m_audio(_audio), m_window_start(clk::now()),
+      m_window_clock(_cpu.get_bus().clock) {}
+
+auto fast_forward::set_active(bool _on) -> void {
+  if (_on == m_active)
+    return;
+  m_active = _on;
+
+  apu &sound = m_cpu.get_bus().sound;
+  if (_on) {
+    m_saved_audio = sound.synthesis();
+    m_saved_video = m_cpu.get_bus().video.render;
+    m_frame = 0;
+    if (m_audio == audio_mode::skip)
+      m_cpu.set_audio_enabled(false);
+  } else {
+    sound.set_decimation(1);
+    m_cpu.set_audio_enabled(m_saved_audio);
+    m_cpu.set_video_enabled(m_saved_video);
+  }
+}
+
+auto fast_forward::frame() -> bool {
+  const bool shown = m_saved_video && m_frame++ % m_render_every == 0;
+  m_cpu.set_video_enabled(shown);
+  m_cpu.run_frame();
+  measure();
+  return shown;
+}
+
+auto fast_forward::measure() -> void {
+  const auto now = clk::now();
+  const auto elapsed = now - m_window_start;
+  if (elapsed < SPEED_WINDOW)
+    return;
+
+  const u64 clock = m_cpu.get_bus().clock;
+  const double emulated =
+      static_cast<double>(clock - m_window_clock) / apu::CLOCK_RATE;
+  m_speed = emulated / std::chrono::duration<double>(elapsed).count();
+  m_window_start = now;
+  m_window_clock = clock;
+
+  // drop as many blocks as we run faster than real time
+  if (m_active && m_audio == audio_mode::decimate)
+    m_cpu.get_bus().sound.set_decimation(
+        static_cast<u32>(std::max(1.0, std::round(m_speed))));
+}
+
+} // namespace mpu
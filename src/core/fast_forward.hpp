@@ -0,0 +1,59 @@
+#ifndef __CORE_FAST_FORWARD_HPP
+#define __CORE_FAST_FORWARD_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+
+namespace mpu {
+
+/**
+ * Fast-forward
+ * @brief uncapped emulation for skipping through intros: frames are not
+ * paced, only every Nth one generates pixels, and audio is either skipped
+ * or decimated to match the measured speed (one block kept per N, faded at
+ * the edges).
+ *
+ * The speed readout (emulated time over wall time) is kept up to date
+ * whether or not fast-forward is active, as long as frame() or measure()
+ * runs once per emulated frame.
+ */
+struct fast_forward {
+  enum class audio_mode : u8 { skip, decimate };
+
+  explicit fast_forward(CPU &_cpu, u32 _render_every = 8,
+                        audio_mode _audio = audio_mode::decimate);
+
+  // switch fast-forward on or off; picture and audio switches are restored
+  // to what they were on entry
+  auto set_active(bool _on) -> void;
+  auto active() const -> bool { return m_active; }
+
+  // emulate one frame uncapped, true when it generated pixels
+  auto frame() -> bool;
+
+  // account for a frame emulated elsewhere (normal paced mode)
+  auto measure() -> void;
+
+  // emulated seconds per wall second, refreshed every SPEED_WINDOW
+  auto speed() const -> double { return m_speed; }
+
+private:
+  constexpr static clk::duration SPEED_WINDOW = std::chrono::milliseconds(500);
+
+  CPU &m_cpu;
+  u32 m_render_every;
+  audio_mode m_audio;
+
+  bool m_active = false;
+  bool m_saved_audio = true;
+  bool m_saved_video = true;
+  u64 m_frame = 0;
+
+  clk::time_point m_window_start;
+  u64 m_window_clock = 0;
+  double m_speed = 1.0;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,53 @@
+#include "frame_hash.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace mpu {
+
+namespace {
+constexpr const char *HEADER = "# gboy frame hashes: frame video memory";
+} // namespace
+
+auto frame_hashes::mismatch(const frame_hashes &_golden) const -> long long {
+  const auto [ours, theirs] =
+      std::mismatch(digests.begin(), digests.end(), _golden.digests.begin(),
+                    _golden.digests.end());
+  if (ours == digests.end() && theirs == _golden.digests.end())
+    return -1;
+  return ours - digests.begin();
+}
+
+auto frame_hashes::save(const std::string &_path) const -> void {
+  std::ofstream file(_path);
+  if (!file)
+    throw mpu_runtime_error("cannot create " + _path);
+  file << HEADER << '\n' << std::hex;
+  for (const frame_digest &digest : digests)
+    file << digest.frame << ' ' << digest.video << ' ' << digest.memory
+         << '\n';
+  if (!file.flush())
+    throw mpu_runtime_error("cannot write " + _path);
+}
+
+auto frame_hashes::load(const std::string &_path) -> frame_hashes {
+  std::ifstream file(_path);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _path);
+
+  frame_hashes result;
+  std::string line;
+  for (std::size_t number = 1; std::getline(file, line); ++number) {
+    if (line.empty() || line.front() == '#')
+      continue;
+    std::istringstream fields(line);
+    frame_digest digest;
+    if (!(fields >> std::hex >> digest.frame >> digest.video >> digest.memory))
+      throw mpu_runtime_error(_path + ":" + std::to_string(number) +
+                              ": expected frame, video and memory hashes");
+    result.digests.push_back(digest);
+  }
+  return result;
+}
+
+} // namespace mpu
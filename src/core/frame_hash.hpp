@@ -0,0 +1,39 @@
+#ifndef __CORE_FRAME_HASH_HPP
+#define __CORE_FRAME_HASH_HPP
+
+#include "common.hpp"
+#include "hash.hpp"
+#include <string>
+#include <vector>
+
+namespace mpu {
+
+// what one VBlank looked like
+struct frame_digest {
+  u64 frame;  // ppu::frames of the VBlank
+  u64 video;  // finished picture, shades 0-3
+  u64 memory; // WRAM and HRAM
+
+  auto operator==(const frame_digest &) const -> bool = default;
+};
+
+/**
+ * Per-frame hash stream
+ * @brief collects a frame_digest at every VBlank while attached to the bus
+ * (mmu::hashes), and reads/writes golden files: a `#` header line, then
+ * one "frame video memory" line per VBlank in hex, so goldens diff well.
+ */
+struct frame_hashes {
+  std::vector<frame_digest> digests;
+
+  // index of the first digest that differs from _golden, including one
+  // stream ending early; -1 when they match
+  auto mismatch(const frame_hashes &_golden) const -> long long;
+
+  auto save(const std::string &_path) const -> void;
+  static auto load(const std::string &_path) -> frame_hashes;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,74 @@
+#include "frame_queue.hpp"
+#include <thread>
+
+namespace mpu {
+
+frame_queue::frame_queue(std::size_t _depth, policy _policy)
+    : m_depth(_depth), m_policy(_policy),
+      m_buffers(std::make_unique<video_frame[]>(_depth + 2)) {
+  if (_depth == 0 || _depth > MAX_DEPTH)
+    throw mpu_runtime_error("frame queue depth must be 1-16");
+}
+
+auto frame_queue::publish() -> bool {
+  const u64 head = m_head.load(std::memory_order_relaxed);
+  bool kept = true;
+
+  if (head - m_tail.load(std::memory_order_acquire) == m_depth) {
+    if (m_policy == policy::backpressure) {
+      while (head - m_tail.load(std::memory_order_acquire) == m_depth)
+        std::this_thread::yield();
+    } else {
+      // losing the race just means the consumer made room for us
+      u64 oldest = head - m_depth;
+      if (m_tail.compare_exchange_strong(oldest, oldest + 1,
+                                         std::memory_order_seq_cst)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        kept = false;
+      }
+    }
+  }
+
+  m_ring[head % m_depth].store(m_writing, std::memory_order_relaxed);
+  m_head.store(head + 1, std::memory_order_seq_cst);
+  m_writing = __free_buffer();
+  return kept;
+}
+
+auto frame_queue::acquire() -> const video_frame * {
+  for (;;) {
+    u64 tail = m_tail.load(std::memory_order_seq_cst);
+    if (tail == m_head.load(std::memory_order_acquire)) {
+      release();
+      return nullptr;
+    }
+
+    // announce the buffer before claiming it, so the producer never picks
+    // it as free in between; a stale id from a lost race is harmless
+    const u8 id = m_ring[tail % m_depth].load(std::memory_order_relaxed);
+    m_held.store(id, std::memory_order_seq_cst);
+    if (m_tail.compare_exchange_strong(tail, tail + 1,
+                                       std::memory_order_seq_cst))
+      return &m_buffers[id];
+  }
+}
+
+// any buffer neither queued nor held; the queue is scanned before the held
+// id is read, so a frame the consumer claims meanwhile is seen in one of them
+auto frame_queue::__free_buffer() const -> u8 {
+  std::array<bool, MAX_DEPTH + 2> used{};
+  const u64 head = m_head.load(std::memory_order_relaxed);
+  for (u64 seq = m_tail.load(std::memory_order_seq_cst); seq < head; ++seq)
+    used[m_ring[seq % m_depth].load(std::memory_order_relaxed)] = true;
+
+  const u8 held = m_held.load(std::memory_order_seq_cst);
+  if (held != NONE)
+    used[held] = true;
+
+  for (u8 id = 0; id < m_depth + 2; ++id)
+    if (!used[id])
+      return id;
+  throw mpu_runtime_error("frame queue has no free buffer");
+}
+
+} // namespace mpu
@@ -0,0 +1,91 @@
+#ifndef __CORE_FRAME_QUEUE_HPP
+#define __CORE_FRAME_QUEUE_HPP
+
+#include "common.hpp"
+#include "ppu.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace mpu {
+
+// one finished picture as handed out by the frame queue
+struct video_frame {
+  u64 index = 0; // PPU frame counter at VBlank
+  u64 clock = 0; // bus clock at VBlank
+  std::array<u8, ppu::WIDTH * ppu::HEIGHT> pixels{}; // shade 0-3 per pixel
+};
+
+/**
+ * Single-producer/single-consumer frame queue
+ * @brief preallocated framebuffers the PPU renders into directly and
+ * publishes at VBlank, for consumers running on other cores.
+ *
+ * Nothing is copied: the PPU draws into back(), the consumer reads the
+ * frame returned by acquire() in place until its next acquire() or
+ * release(). When the queue is full the producer either drops the oldest
+ * queued frame (frontends, which want the latest picture) or waits for the
+ * consumer (recorders, which must not lose any).
+ */
+struct frame_queue {
+  enum class policy : u8 { drop_oldest, backpressure };
+
+  constexpr static std::size_t MAX_DEPTH = 16;
+
+  explicit frame_queue(std::size_t _depth = 3,
+                       policy _policy = policy::drop_oldest);
+
+  frame_queue(const frame_queue &) = delete;
+  frame_queue &operator=(const frame_queue &) = delete;
+
+  // producer side: frame being drawn
+  auto back() -> video_frame & { return m_buffers[m_writing]; }
+
+  // producer side: queue back() and start drawing into a free buffer,
+  // returns false if the oldest queued frame had to be dropped
+  auto publish() -> bool;
+
+  // consumer side: oldest queued frame, nullptr while empty; the frame
+  // returned by the previous call is given back either way
+  auto acquire() -> const video_frame *;
+
+  // consumer side: give the last acquired frame back without taking another
+  auto release() -> void { m_held.store(NONE, std::memory_order_seq_cst); }
+
+  // frames waiting for the consumer
+  auto size() const -> std::size_t {
+    return m_head.load(std::memory_order_acquire) -
+           m_tail.load(std::memory_order_acquire);
+  }
+
+  auto depth() const -> std::size_t { return m_depth; }
+  auto dropped() const -> u64 {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  constexpr static u8 NONE = 0xFF;
+
+  std::size_t m_depth;
+  policy m_policy;
+
+  // depth queued + one being drawn + one held by the consumer
+  std::unique_ptr<video_frame[]> m_buffers;
+  u8 m_writing = 0;
+
+  // ring of buffer ids, the sequence numbers grow forever; the producer
+  // may also advance m_tail to drop the oldest frame, so both sides claim
+  // from it with a CAS
+  std::array<std::atomic<u8>, MAX_DEPTH> m_ring{};
+  alignas(64) std::atomic<u64> m_head{0};
+  alignas(64) std::atomic<u64> m_tail{0};
+  alignas(64) std::atomic<u8> m_held{NONE};
+  std::atomic<u64> m_dropped{0};
+
+  auto __free_buffer() const -> u8;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,17 @@
+#include "hash.hpp"
+#include "cpu.hpp"
+#include "state_io.hpp"
+#include <memory>
+#include <vector>
+
+namespace mpu {
+
+auto machine_hash(const CPU &_cpu) -> u64 {
+  const auto state = std::make_unique<CPU::snapshot>();
+  _cpu.save(*state);
+  std::vector<u8> bytes;
+  encode_state(*state, bytes);
+  return hash64(bytes.data(), bytes.size(), 0);
+}
+
+} // namespace mpu
@@ -0,0 +1,52 @@
+#ifndef __CORE_HASH_HPP
+#define __CORE_HASH_HPP
+
+#include "common.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace mpu {
+
+struct CPU;
+
+// 64-bit multiply-xorshift hash over 8-byte words, for state comparison
+// (not cryptographic); a few GB/s, so hashing RAM every frame is cheap
+inline auto hash64(const void *_data, std::size_t _size, u64 _seed = 0)
+    -> u64 {
+  constexpr u64 PRIME = 0x9E3779B97F4A7C15ull;
+  const auto *bytes = static_cast<const u8 *>(_data);
+  u64 h = _seed ^ (_size * PRIME);
+
+  auto mix = [&](u64 _word) {
+    h ^= _word * PRIME;
+    h = std::rotl(h, 29) * 0xBF58476D1CE4E5B9ull;
+  };
+  for (; _size >= 8; _size -= 8, bytes += 8) {
+    u64 word;
+    std::memcpy(&word, bytes, 8);
+    mix(word);
+  }
+  if (_size) {
+    u64 word = 0;
+    std::memcpy(&word, bytes, _size);
+    mix(word);
+  }
+
+  h ^= h >> 31;
+  h *= 0x94D049BB133111EBull;
+  return h ^ (h >> 29);
+}
+
+template <typename T> inline auto hash64(const T &_value, u64 _seed) -> u64 {
+  return hash64(&_value, sizeof(_value), _seed);
+}
+
+// every field of the machine's snapshot (state_io.hpp): registers, IME
+// and HALT, memory, PPU and APU timing, serial, joypad, cartridge banks
+// and RTC; the link cable and host outputs are left out
+auto machine_hash(const CPU &_cpu) -> u64;
+
+} // namespace mpu
+
+#endif
@@ -1,5 +1,6 @@
 #include "common.hpp"
 #include "cpu.hpp"
+#include <bit>
 
 mpu::mpu_runtime_error::mpu_runtime_error(std::string &&__message)
     : std::runtime_error(__message) {}
@@ -10,6 +11,57 @@ auto mpu::TODO(std::string &&__message) -> void {
 
 namespace mpu {
 
+// T-cycles per unprefixed opcode, conditional branches at their not-taken
+// cost; 0 for the CB prefix, which has no decoder yet
+const std::array<u8, 0x100> CPU::OPCODE_CYCLES = {
+    // x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF
+    4,  12, 8,  8,  4,  4,  8,  4,  20, 8,  8,  8,  4,  4,  8,  4,  // 0x
+    4,  12, 8,  8,  4,  4,  8,  4,  12, 8,  8,  8,  4,  4,  8,  4,  // 1x
+    8,  12, 8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,  // 2x
+    8,  12, 8,  8,  12, 12, 12, 4,  8,  8,  8,  8,  4,  4,  8,  4,  // 3x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 4x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 5x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 6x
+    8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,  // 7x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 8x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 9x
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // Ax
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // Bx
+    8,  12, 12, 16, 12, 16, 8,  16, 8,  16, 12, 0,  12, 24, 8,  16, // Cx
+    8,  12, 12, 4,  12, 16, 8,  16, 8,  16, 12, 4,  12, 4,  8,  16, // Dx
+    12, 12, 8,  4,  4,  16, 8,  16, 16, 4,  16, 4,  4,  4,  8,  16, // Ex
+    12, 12, 8,  4,  4,  16, 8,  16, 12, 8,  16, 4,  4,  4,  8,  16, // Fx
+};
+
+// extra T-cycles charged when a conditional branch is taken
+const std::array<u8, 0x100> CPU::BRANCH_CYCLES = [] {
+  std::array<u8, 0x100> extra{};
+  for (u8 op : {0x20, 0x28, 0x30, 0x38}) // JR cc, e
+    extra[op] = 4;
+  for (u8 op : {0xC2, 0xCA, 0xD2, 0xDA}) // JP cc, nn
+    extra[op] = 4;
+  for (u8 op : {0xC4, 0xCC, 0xD4, 0xDC}) // CALL cc, nn
+    extra[op] = 12;
+  for (u8 op : {0xC0, 0xC8, 0xD0, 0xD8}) // RET cc
+    extra[op] = 12;
+  return extra;
+}();
+
+auto CPU::__service_interrupt() -> void {
+  const u8 pending =
+      bus.interrupt_enable & bus.io_regs[mmu::IF - 0xFF00] & 0x1F;
+  const u8 line = static_cast<u8>(std::countr_zero(pending));
+
+  INTERRUPT_ENABLE = false;
+  bus.io_regs[mmu::IF - 0xFF00] &= static_cast<u8>(~(1 << line));
+
+  set_sp(get_sp().SP - 2);
+  bus.set_u8(get_sp().SP, get_pc() & 0xFF);
+  bus.set_u8(get_sp().SP + 1, (get_pc() >> 8) & 0xFF);
+  set_pc(static_cast<u16>(0x40 + 8 * line));
+  bus.tick(20);
+}
+
 auto CPU::execute_instruction(u8 _opcode) -> void {
   [[maybe_unused]] u8 value_u8;
   [[maybe_unused]] u16 value_u16;
@@ -20,7 +72,6 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
   case 0x0:
     switch ((_opcode & 0x0F)) {
     case 0x0: // 0x00 NOP
-      TODO("NOP");
       break;
 
     case 0x1: // 0x01 LD BC, u16
@@ -46,13 +97,13 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // carry flag is not changed
 
       // test for zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // test for half carry
-      if ((0 == (value_u8 & 0x10)) && (0 != (++value_u8 & 0x10)))
+      if ((value_u8 & 0x0F) + 1 > 0x0F)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -152,13 +203,13 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // carry flag is not changed
 
       // test for zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // test for half carry
-      if ((0 == (value_u8 & 0x10)) && (0 != (++value_u8 & 0x10)))
+      if ((value_u8 & 0x0F) + 1 > 0x0F)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -242,13 +293,13 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // carry flag is not changed
 
       // test for zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // test for half carry
-      if ((0 == (value_u8 & 0x10)) && (0 != (++value_u8 & 0x10)))
+      if ((value_u8 & 0x0F) + 1 > 0x0F)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -270,6 +321,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       // Subtract flag (always set for DEC)
       flags |= SUBTRACT_FLAG;
+
+      // Half-carry: borrow from bit 4
+      if ((value_u8 & 0x0F) == 0)
+        flags |= HALF_FLAG;
+      else
+        flags &= ~HALF_FLAG;
+
+      set_d(result);
     } break;
 
     case 0x6: // 0x16 LD D, u8
@@ -342,7 +401,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // carry flag is not changed
 
       // test for zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -405,6 +464,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~HALF_FLAG;
     } break;
     }
+    break;
 
   case 0x2:
     switch ((_opcode & 0x0F)) {
@@ -441,7 +501,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // carry flag is not changed
 
       // test for zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -575,7 +635,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_l(value_u8 + 1);
 
       // zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -628,6 +688,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= HALF_FLAG;
     } break;
     }
+    break;
 
   case 0x3:
     switch ((_opcode & 0x0F)) {
@@ -725,7 +786,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u8 + 1);
 
       // zero flag
-      if (0 == value_u8 + 1)
+      if (0 == static_cast<u8>(value_u8 + 1))
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -780,7 +841,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
     switch ((_opcode & 0x0F)) {
     case 0x0: // 0x40 LD B, B
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0x1: // 0x41 LD B, C
@@ -833,7 +894,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0x9: // 0x49 LD C, C
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0xA: // 0x49 LD C, D
@@ -890,7 +951,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0x2: // 0x52 LD D, D
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0x3: // 0x53 LD D, E
@@ -943,7 +1004,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0xB: // 0x5B LD E, E
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0xC: // 0x5C LD E, H
@@ -1000,7 +1061,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0x4: // 0x64 LD H, H
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0x5: // 0x65 LD H, L
@@ -1053,7 +1114,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0xD: // 0x6D LD L, L
     {
-      TODO("NOP"); // NOP disguised as LD instruction
+      // NOP disguised as LD instruction
     } break;
 
     case 0xE: // 0x6E LD L, [HL]
@@ -1110,7 +1171,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0x6: // 0x76 HALT
     {
-      // TODO: implement HALT
+      halt();
     } break;
 
     case 0x7: // 0x77 LD [HL], A
@@ -1182,7 +1243,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // set zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1209,7 +1270,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       flags &= ~SUBTRACT_FLAG;
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1234,7 +1295,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       flags &= ~SUBTRACT_FLAG;
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1259,7 +1320,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       flags &= ~SUBTRACT_FLAG;
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1284,7 +1345,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       flags &= ~SUBTRACT_FLAG;
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1302,18 +1363,19 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
     case 0x5: // 0x85 ADD A, L
     {
-      value_u8 = get_psw().A;
-      value_u16 = get_psw().A + get_hl().L;
+      value_u8 = get_hl().L;
+      u8 acc = get_psw().A;
+      value_u16 = acc + value_u8;
       set_acc(value_u16 & 0xFF);
 
       flags &= ~SUBTRACT_FLAG;
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
-      if ((value_u8 & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1334,7 +1396,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1360,7 +1422,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (acc + acc == 0)
+      if (static_cast<u8>(acc + acc) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1388,13 +1450,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1416,13 +1479,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1444,13 +1508,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1472,13 +1537,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1500,13 +1566,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1528,13 +1595,14 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (value_u8 & 0xF) > 0xF)
+      if ((acc & 0xF) + (value_u8 & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) >
+          0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1556,7 +1624,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1583,13 +1651,13 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
 
       // half carry flag
-      if ((acc & 0xF) + (acc & 0xF) > 0xF)
+      if ((acc & 0xF) + (acc & 0xF) + ((flags & CARRY_FLAG) ? 1 : 0) > 0xF)
         flags |= HALF_FLAG;
       else
         flags &= ~HALF_FLAG;
@@ -1615,7 +1683,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1643,7 +1711,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1671,7 +1739,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1699,7 +1767,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1727,7 +1795,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1755,7 +1823,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1783,7 +1851,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1810,7 +1878,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1838,7 +1906,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1866,7 +1934,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1906,7 +1974,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1934,7 +2002,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1962,7 +2030,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -1990,7 +2058,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2020,7 +2088,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2047,7 +2115,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
         flags &= ~CARRY_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2067,7 +2135,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2089,7 +2157,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2111,7 +2179,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2133,7 +2201,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2155,7 +2223,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2177,7 +2245,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2199,7 +2267,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2216,7 +2284,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       // only flags affected
       flags &= ~SUBTRACT_FLAG;
 
-      if (get_psw().A & 0xFF == 0)
+      if (get_psw().A == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2233,7 +2301,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2253,7 +2321,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
 
       // zero flag
 
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2272,7 +2340,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2291,7 +2359,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2310,7 +2378,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2329,7 +2397,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2348,7 +2416,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2366,7 +2434,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       set_acc(value_u16 & 0xFF);
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2392,7 +2460,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2414,7 +2482,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2437,7 +2505,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2460,7 +2528,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2483,7 +2551,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2506,7 +2574,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2529,7 +2597,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2551,7 +2619,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2573,7 +2641,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2601,7 +2669,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2629,7 +2697,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2657,7 +2725,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2685,7 +2753,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2713,7 +2781,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2741,7 +2809,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2840,7 +2908,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -2927,7 +2995,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -3011,7 +3079,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -3086,7 +3154,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags |= SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -3152,7 +3220,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -3223,7 +3291,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -3294,7 +3362,7 @@ auto CPU::execute_instruction(u8 _opcode) -> void {
       flags &= ~SUBTRACT_FLAG;
 
       // zero flag
-      if (value_u16 & 0xFF == 0)
+      if ((value_u16 & 0xFF) == 0)
         flags |= ZERO_FLAG;
       else
         flags &= ~ZERO_FLAG;
@@ -0,0 +1,66 @@
+#ifndef __CORE_JOYPAD_HPP
+#define __CORE_JOYPAD_HPP
+
+#include "common.hpp"
+
+namespace mpu {
+
+/**
+ * Joypad (P1 0xFF00)
+ * @brief eight buttons read as two 4-bit rows selected by P1 bits 4-5,
+ * active low; a selected line going low requests the joypad interrupt.
+ *
+ * The host sets the whole pad at once with set(), normally once per
+ * frame, which keeps input a pure function of the frame number.
+ */
+struct joypad {
+  enum button : u8 {
+    RIGHT = 0x01,
+    LEFT = 0x02,
+    UP = 0x04,
+    DOWN = 0x08,
+    A = 0x10,
+    B = 0x20,
+    SELECT = 0x40,
+    START = 0x80,
+  };
+
+  u8 buttons = 0; // pressed buttons, one bit per button
+  u8 select = 0x30; // P1 bits 4-5 as last written
+
+  auto read() const -> u8 { return 0xC0 | select | __lines(); }
+
+  // true when a selected line fell, i.e. the interrupt should be requested
+  auto write(u8 _value) -> bool {
+    const u8 before = __lines();
+    select = _value & 0x30;
+    return before & ~__lines();
+  }
+
+  auto set(u8 _buttons) -> bool {
+    const u8 before = __lines();
+    buttons = _buttons;
+    return before & ~__lines();
+  }
+
+  // members in encoding order, see state_io.hpp
+  template <typename S, typename F>
+  static auto fields(S &_s, F &&_f) -> void {
+    _f(_s.buttons, _s.select);
+  }
+
+private:
+  // low nibble of P1, 0 for a pressed button in a selected row
+  auto __lines() const -> u8 {
+    u8 pressed = 0;
+    if (!(select & 0x10))
+      pressed |= buttons & 0x0F;
+    if (!(select & 0x20))
+      pressed |= buttons >> 4;
+    return static_cast<u8>(~pressed & 0x0F);
+  }
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __CORE_LINK_HPP
+#define __CORE_LINK_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include <algorithm>
+
+namespace mpu {
+
+/**
+ * In-process link cable
+ * @brief plugs the serial ports of two CPUs into each other and schedules
+ * both cores in bounded time slices.
+ *
+ * A transfer completes at an exact point of the master's clock; the slave
+ * sees the byte at the same point of its own clock, or at the start of its
+ * next slice if it already ran past it, so the slice length bounds the skew.
+ * The default slice is one scanline, far below the 4096 cycles a byte takes.
+ */
+struct link_cable {
+  constexpr static u64 DEFAULT_SLICE = 456;
+
+  link_cable(CPU &_first, CPU &_second, u64 _slice = DEFAULT_SLICE)
+      : m_first(_first), m_second(_second), m_slice(_slice),
+        m_first_base(_first.get_bus().clock),
+        m_second_base(_second.get_bus().clock) {
+    serial &a = m_first.get_bus().link;
+    serial &b = m_second.get_bus().link;
+    const auto skew = static_cast<long long>(m_second_base) -
+                      static_cast<long long>(m_first_base);
+
+    a.peer = &b;
+    b.peer = &a;
+    a.skew = skew;
+    b.skew = -skew;
+  }
+
+  ~link_cable() {
+    m_first.get_bus().link.peer = nullptr;
+    m_second.get_bus().link.peer = nullptr;
+  }
+
+  link_cable(const link_cable &) = delete;
+  link_cable &operator=(const link_cable &) = delete;
+
+  // run both cores for _cycles T-cycles, alternating every slice
+  auto run_for(u64 _cycles) -> void {
+    const u64 end = m_elapsed + _cycles;
+
+    while (m_elapsed < end) {
+      m_elapsed += std::min(m_slice, end - m_elapsed);
+      m_first.run_until(m_first_base + m_elapsed);
+      m_second.run_until(m_second_base + m_elapsed);
+    }
+  }
+
+private:
+  CPU &m_first;
+  CPU &m_second;
+  u64 m_slice;
+
+  // cable time is counted from the moment both ends were plugged in
+  u64 m_first_base;
+  u64 m_second_base;
+  u64 m_elapsed = 0;
+};
+
+} // namespace mpu
+
+#endif
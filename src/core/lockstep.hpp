@@ -0,0 +1,287 @@
+#ifndef __CORE_LOCKSTEP_HPP
+#define __CORE_LOCKSTEP_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace mpu {
+
+// one register column of the lockstep engine
+template <std::size_t LANES> struct lane_vector;
+template <> struct lane_vector<8> {
+  typedef u16 type __attribute__((vector_size(16)));
+};
+template <> struct lane_vector<16> {
+  typedef u16 type __attribute__((vector_size(32)));
+};
+
+/**
+ * Lockstep multi-instance interpreter (experimental)
+ * @brief runs N copies of the same ROM with their registers stored as a
+ * structure-of-arrays; every lane whose pc (and fetched opcode) matches
+ * executes register-only instructions together in SIMD, the rest fall
+ * back to the scalar CPU::execute_instruction of that lane.
+ *
+ * Lane registers are widened to u16 so a full register column is one
+ * 128-bit (8 lanes) or 256-bit (16 lanes) vector, which the compiler lowers
+ * to SSE2/AVX2/AVX-512 depending on the target flags (see GBOY_NATIVE).
+ * The vector path follows documented SM83 flag semantics, as the scalar
+ * core does; gboy-lockstep-bench fails if any lane ends up anywhere but
+ * where an independent CPU does. Vector groups advance each lane's bus by
+ * the opcode's fixed cost, and lanes that are halted, have an interrupt to
+ * take or a PC sample due go through CPU::step. Lanes must run the same
+ * ROM image: opcodes below 0x8000 are fetched from the leader lane.
+ */
+template <std::size_t LANES> struct lockstep {
+  static_assert(LANES == 8 || LANES == 16, "lockstep runs 8 or 16 lanes");
+
+  using vec = typename lane_vector<LANES>::type;
+  using lane_mask = u32;
+
+  // register file indices follow the opcode encoding, the (HL) slot holds F
+  enum reg : u8 { B, C, D, E, H, L, F, A };
+
+  std::array<vec, 8> r{};
+  vec sp{};
+  vec pc{};
+
+  // each lane keeps its own cpu for the memory bus and scalar fallback
+  std::vector<CPU> lanes;
+
+  // instructions retired on the vector and scalar paths
+  u64 vector_retired = 0;
+  u64 scalar_retired = 0;
+
+  lockstep() : lanes(LANES) {
+    for (std::size_t i = 0; i < LANES; ++i)
+      __fill(i);
+  }
+
+  // copy lane registers from the SoA file into the lane's cpu and back,
+  // call these around any direct access to lanes[i]
+  auto sync_to_lanes() -> void {
+    for (std::size_t i = 0; i < LANES; ++i)
+      __spill(i);
+  }
+  auto sync_from_lanes() -> void {
+    for (std::size_t i = 0; i < LANES; ++i)
+      __fill(i);
+  }
+
+  // retire one instruction on every lane
+  auto step() -> void {
+    const lane_mask all = (lane_mask{1} << LANES) - 1;
+    lane_mask remaining = all;
+
+    // halted lanes, lanes about to take an interrupt and lanes with a PC
+    // sample due go through the scalar step, which handles all three
+    for (std::size_t i = 0; i < LANES; ++i) {
+      if (__needs_scalar(lanes[i])) {
+        __spill(i);
+        lanes[i].step();
+        __fill(i);
+        remaining &= ~(lane_mask{1} << i);
+        ++scalar_retired;
+      }
+    }
+
+    while (remaining) {
+      const auto leader = static_cast<std::size_t>(std::countr_zero(remaining));
+      const u16 at = pc[leader];
+      const u8 opcode = lanes[leader].get_bus().at(at);
+
+      // lanes sitting on the same pc and fetching the same opcode run together;
+      // ROM is shared by contract so only RAM code needs a per-lane fetch
+      const vec same = (vec)(pc == (vec{} + at));
+      lane_mask group = 0;
+      for (std::size_t i = 0; i < LANES; ++i)
+        group |= static_cast<lane_mask>(same[i] & 1) << i;
+      group &= remaining;
+      if (at >= 0x8000) {
+        for (std::size_t i = 0; i < LANES; ++i) {
+          if ((group >> i & 1) && lanes[i].get_bus().at(at) != opcode)
+            group &= ~(lane_mask{1} << i);
+        }
+      }
+      remaining &= ~group;
+
+      if (__vectorizable(opcode)) {
+        if (group == all) {
+          __execute(opcode, ~vec{});
+        } else {
+          vec mask{};
+          for (std::size_t i = 0; i < LANES; ++i)
+            mask[i] = static_cast<u16>(-(group >> i & 1));
+          __execute(opcode, mask);
+        }
+        vector_retired += static_cast<u64>(std::popcount(group));
+        // vector opcodes never branch, their cost is fixed
+        for (std::size_t i = 0; i < LANES; ++i)
+          if (group >> i & 1)
+            lanes[i].get_bus().tick(CPU::OPCODE_CYCLES[opcode]);
+      } else {
+        for (std::size_t i = 0; i < LANES; ++i) {
+          if (!(group >> i & 1))
+            continue;
+          __spill(i);
+          lanes[i].step();
+          __fill(i);
+          ++scalar_retired;
+        }
+      }
+    }
+  }
+
+private:
+  static auto __needs_scalar(const CPU &_cpu) -> bool {
+    const mmu &bus = _cpu.get_bus();
+    const bool pending =
+        bus.interrupt_enable & bus.io_regs[mmu::IF - 0xFF00] & 0x1F;
+    return _cpu.halted() || (_cpu.INTERRUPT_ENABLE && pending) ||
+           bus.clock >= _cpu.sampler.due();
+  }
+
+  /**
+   * @brief register-only instructions with no memory operand:
+   * NOP, LD r, r', INC r, DEC r and the ALU A, r block. Trace and profile
+   * builds record every instruction in CPU::step, so they take none.
+   */
+  static constexpr auto __vectorizable(u8 _opcode) -> bool {
+    const u8 dst = (_opcode >> 3) & 0x7;
+    const u8 src = _opcode & 0x7;
+
+#if defined(GBOY_TRACE) || defined(GBOY_PROFILE)
+    return false;
+#endif
+    if (_opcode == 0x00)
+      return true;
+    if ((_opcode & 0xC7) == 0x04 || (_opcode & 0xC7) == 0x05) // INC r, DEC r
+      return _opcode < 0x40 && dst != 6;
+    if (_opcode >= 0x40 && _opcode < 0x80) // LD r, r'
+      return dst != 6 && src != 6;
+    if (_opcode >= 0x80 && _opcode < 0xC0) // ALU A, r
+      return src != 6;
+    return false;
+  }
+
+  [[gnu::always_inline]] static auto __blend(vec _old, vec _new, vec _mask) -> vec {
+    return (_old & ~_mask) | (_new & _mask);
+  }
+
+  // vector compares yield 0/0xFFFF per lane, shift that into a single bit
+  [[gnu::always_inline]] static auto __bit(vec _cond, int _shift) -> vec {
+    return (vec)((_cond & 1) << _shift);
+  }
+
+  [[gnu::always_inline]] auto __execute(u8 _opcode, vec _mask) -> void {
+    const u8 dst = (_opcode >> 3) & 0x7;
+    const u8 src = _opcode & 0x7;
+    const vec zero{};
+    const vec f = r[F];
+
+    if (_opcode == 0x00) {
+      // NOP
+    } else if (_opcode < 0x40) {
+      const vec value = r[dst];
+      vec result;
+      vec flags = f & CPU::CARRY_FLAG;
+
+      if ((_opcode & 0x7) == 0x4) { // INC r
+        result = (value + 1) & 0xFF;
+        flags |= __bit((vec)((value & 0xF) == 0xF), 5);
+      } else { // DEC r
+        result = (value - 1) & 0xFF;
+        flags |= CPU::SUBTRACT_FLAG;
+        flags |= __bit((vec)((value & 0xF) == zero), 5);
+      }
+      flags |= __bit((vec)(result == zero), 7);
+
+      r[dst] = __blend(r[dst], result, _mask);
+      r[F] = __blend(f, flags, _mask);
+    } else if (_opcode < 0x80) { // LD r, r'
+      r[dst] = __blend(r[dst], r[src], _mask);
+    } else { // ALU A, r
+      const vec a = r[A];
+      const vec b = r[src];
+      const vec carry = (f >> 4) & 1;
+      vec result;
+      vec flags{};
+
+      switch (dst) {
+      case 0: // ADD
+      case 1: // ADC
+      {
+        const vec c = dst == 1 ? carry : zero;
+        result = a + b + c;
+        flags = __bit((vec)(((a & 0xF) + (b & 0xF) + c) > 0xF), 5) |
+                __bit((vec)(result > 0xFF), 4);
+      } break;
+      case 2: // SUB
+      case 3: // SBC
+      case 7: // CP
+      {
+        const vec c = dst == 3 ? carry : zero;
+        result = a - b - c;
+        flags = CPU::SUBTRACT_FLAG |
+                __bit((vec)((a & 0xF) < ((b & 0xF) + c)), 5) |
+                __bit((vec)(a < (b + c)), 4);
+      } break;
+      case 4: // AND
+        result = a & b;
+        flags = zero + CPU::HALF_FLAG;
+        break;
+      case 5: // XOR
+        result = a ^ b;
+        break;
+      default: // OR
+        result = a | b;
+        break;
+      }
+      result &= 0xFF;
+      flags |= __bit((vec)(result == zero), 7);
+
+      if (dst != 7)
+        r[A] = __blend(a, result, _mask);
+      r[F] = __blend(f, flags, _mask);
+    }
+    pc += _mask & 1;
+  }
+
+  // SoA -> lane cpu
+  auto __spill(std::size_t _lane) -> void {
+    CPU &cpu = lanes[_lane];
+    cpu.set_acc(static_cast<u8>(r[A][_lane]));
+    cpu.set_flags(static_cast<u8>(r[F][_lane]));
+    cpu.set_b(static_cast<u8>(r[B][_lane]));
+    cpu.set_c(static_cast<u8>(r[C][_lane]));
+    cpu.set_d(static_cast<u8>(r[D][_lane]));
+    cpu.set_e(static_cast<u8>(r[E][_lane]));
+    cpu.set_h(static_cast<u8>(r[H][_lane]));
+    cpu.set_l(static_cast<u8>(r[L][_lane]));
+    cpu.set_sp(sp[_lane]);
+    cpu.set_pc(pc[_lane]);
+  }
+
+  // lane cpu -> SoA
+  auto __fill(std::size_t _lane) -> void {
+    CPU &cpu = lanes[_lane];
+    r[A][_lane] = cpu.get_psw().A;
+    r[F][_lane] = cpu.get_psw().F;
+    r[B][_lane] = cpu.get_bc().B;
+    r[C][_lane] = cpu.get_bc().C;
+    r[D][_lane] = cpu.get_de().D;
+    r[E][_lane] = cpu.get_de().E;
+    r[H][_lane] = cpu.get_hl().H;
+    r[L][_lane] = cpu.get_hl().L;
+    sp[_lane] = cpu.get_sp().SP;
+    pc[_lane] = cpu.get_pc();
+  }
+};
+
+} // namespace mpu
+
+#endif
@@ -1,39 +1,167 @@
 #ifndef __CORE_MEMORY_HPP
 #define __CORE_MEMORY_HPP
 
+#include "apu.hpp"
+#include "cartridge.hpp"
 #include "common.hpp"
+#include "frame_hash.hpp"
+#include "joypad.hpp"
+#include "ppu.hpp"
+#include "serial.hpp"
+#include <algorithm>
 #include <array>
 #include <cstddef>
+#include <span>
 
 namespace mpu {
 
+// interrupt request bits of IF (0xFF0F) and IE (0xFFFF)
+enum interrupt : u8 {
+  VBLANK = 0x01,
+  LCD_STAT = 0x02,
+  TIMER = 0x04,
+  SERIAL = 0x08,
+  JOYPAD = 0x10,
+};
+
 /**
  * Memory Management Unit
  * @brief performs memory read/write operations
  */
 struct mmu {
   // 64 KiB of memory
-  std::array<u8, 0x4000> rom_bank0 {};   // 0x0000-3FFF
-  std::array<u8, 0x4000> rom_bankn {};   // 0x4000-7FFF
+  cartridge cart {};                     // 0x0000-7FFF, 0xA000-BFFF
   std::array<u8, 0x2000> vram {};        // 0x8000-9FFF
-  std::array<u8, 0x2000> eram {};        // 0xA000-BFFF
   std::array<u8, 0x1000> wram0 {};       // 0xC000-CFFF
   std::array<u8, 0x1000> wram1 {};       // 0xD000-DFFF
   std::array<u8, 0xA0>   oam {};         // 0xFE00-FE9F
   std::array<u8, 0x80>   io_regs {};     // 0xFF00-FF7F
   std::array<u8, 0x7F>   hram {};        // 0xFF80-FFFE
   u8 interrupt_enable = 0;               // 0xFFFF
+#ifdef GBOY_FLAT_BUS
+  // single-step test builds: every access goes to plain 64 KiB of RAM,
+  // without banking or IO side effects
+  std::array<u8, 0x10000> flat {};
+#endif
+
+  // IO registers with behaviour behind them
+  constexpr static u16 P1 = 0xFF00;
+  constexpr static u16 SB = 0xFF01;
+  constexpr static u16 SC = 0xFF02;
+  constexpr static u16 IF = 0xFF0F;
+
+  joypad pad {};   // P1 buttons
+  serial link {};  // serial port / link cable end
+  // sound registers; reads catch the APU up to the bus clock
+  mutable apu sound {};
+  ppu video {};    // LCD registers, timing and framebuffer
+  u64 clock = 0;   // T-cycles elapsed on this bus
+  // per-VBlank picture and RAM hashes, collected while attached
+  frame_hashes *hashes = nullptr;
+
+  // advance the bus clock and let timed peripherals catch up
+  void tick(u32 cycles) {
+    clock += cycles;
+    if (link.tick(clock))
+      request(SERIAL);
+    if (const u8 lines = video.tick(clock, vram, oam)) {
+      io_regs[IF - 0xFF00] |= lines;
+      if ((lines & VBLANK) && hashes)
+        __hash_frame();
+    }
+  }
+
+  void request(interrupt line) { io_regs[IF - 0xFF00] |= line; }
+
+  // host input for the coming frame, see joypad::button
+  void set_input(u8 buttons) {
+    if (pad.set(buttons))
+      request(JOYPAD);
+  }
+
+  // earliest clock at which a peripheral may raise an interrupt
+  u64 next_event() const { return std::min(video.next_event, link.next_event); }
+
+  // everything a running game can change; ROM is left out, and so are the
+  // host-facing outputs of the APU and PPU
+  struct state {
+    std::array<u8, 0x2000> vram;
+    cartridge::state cart;
+    std::array<u8, cartridge::MAX_RAM> eram; // cartridge RAM, unused tail zero
+    std::array<u8, 0x1000> wram0;
+    std::array<u8, 0x1000> wram1;
+    std::array<u8, 0xA0> oam;
+    std::array<u8, 0x80> io_regs;
+    std::array<u8, 0x7F> hram;
+    u8 interrupt_enable;
+    joypad pad;
+    serial link;
+    apu::state sound;
+    ppu::state video;
+    u64 clock;
+
+    // members in encoding order, see state_io.hpp
+    template <typename S, typename F>
+    static auto fields(S &_s, F &&_f) -> void {
+      _f(_s.vram, _s.cart, _s.eram, _s.wram0, _s.wram1, _s.oam, _s.io_regs,
+       _s.hram, _s.interrupt_enable, _s.pad, _s.link, _s.sound, _s.video,
+       _s.clock);
+    }
+  };
+
+  void save(state &s) const {
+    s.vram = vram;
+    cart.save(s.cart);
+    std::copy(cart.ram().begin(), cart.ram().end(), s.eram.begin());
+    s.wram0 = wram0;
+    s.wram1 = wram1;
+    s.oam = oam;
+    s.io_regs = io_regs;
+    s.hram = hram;
+    s.interrupt_enable = interrupt_enable;
+    s.pad = pad;
+    s.link = link;
+    sound.save(s.sound);
+    video.save(s.video);
+    s.clock = clock;
+  }
+
+  // the link cable stays as it is now, only the port registers roll back
+  void load(const state &s) {
+    vram = s.vram;
+    cart.load(s.cart);
+    std::copy_n(s.eram.begin(), cart.ram().size(), cart.ram().begin());
+    wram0 = s.wram0;
+    wram1 = s.wram1;
+    oam = s.oam;
+    io_regs = s.io_regs;
+    hram = s.hram;
+    interrupt_enable = s.interrupt_enable;
+    pad = s.pad;
+    serial *const peer = link.peer;
+    const long long skew = link.skew;
+    link = s.link;
+    link.peer = peer;
+    link.skew = skew;
+    sound.load(s.sound);
+    video.load(s.video);
+    clock = s.clock;
+  }
+
+  // insert a cartridge; see cartridge::attach_save for persistent RAM
+  void load_rom(std::span<const u8> image) { cart.load(image); }
 
   // Read
   u8 at(u16 addr) const {
-    if (addr < 0x4000) {
-      return rom_bank0[addr];
-    } else if (addr < 0x8000) {
-      return rom_bankn[addr - 0x4000];
+#ifdef GBOY_FLAT_BUS
+    return flat[addr];
+#endif
+    if (addr < 0x8000) {
+      return cart.read_rom(addr);
     } else if (addr < 0xA000) {
       return vram[addr - 0x8000];
     } else if (addr < 0xC000) {
-      return eram[addr - 0xA000];
+      return cart.read_ram(addr);
     } else if (addr < 0xD000) {
       return wram0[addr - 0xC000];
     } else if (addr < 0xE000) {
@@ -45,7 +173,20 @@ struct mmu {
     } else if (addr < 0xFF00) {
       return 0xFF;
     } else if (addr < 0xFF80) {
-      return io_regs[addr - 0xFF00];
+      if (addr >= apu::NR10 && addr < apu::WAVE_RAM + 0x10)
+        return sound.read(addr, clock);
+      if (addr >= ppu::LCDC && addr <= ppu::WX)
+        return video.read(addr);
+      switch (addr) {
+      case P1:
+        return pad.read();
+      case SB:
+        return link.data;
+      case SC:
+        return link.read_control();
+      default:
+        return io_regs[addr - 0xFF00];
+      }
     } else if (addr < 0xFFFF) {
       return hram[addr - 0xFF80];
     } else if (addr == 0xFFFF) {
@@ -56,14 +197,17 @@ struct mmu {
 
   // Write
   void set_u8(u16 addr, u8 value) {
-    if (addr < 0x4000) {
-      // ROM bank 1 not writable in gboy
-    } else if (addr < 0x8000) {
-      // ROM bank n not writable in gboy
+#ifdef GBOY_FLAT_BUS
+    flat[addr] = value;
+    return;
+#endif
+    if (addr < 0x8000) {
+      // ROM is read-only, writes go to the bank controller
+      cart.write_control(addr, value, clock);
     } else if (addr < 0xA000) {
       vram[addr - 0x8000] = value;
     } else if (addr < 0xC000) {
-      eram[addr - 0xA000] = value;
+      cart.write_ram(addr, value, clock);
     } else if (addr < 0xD000) {
       wram0[addr - 0xC000] = value;
     } else if (addr < 0xE000) {
@@ -77,7 +221,30 @@ struct mmu {
     } else if (addr < 0xFF00) {
       // Unusable memory area
     } else if (addr < 0xFF80) {
-      io_regs[addr - 0xFF00] = value;
+      if (addr >= apu::NR10 && addr < apu::WAVE_RAM + 0x10) {
+        sound.write(addr, value, clock);
+        return;
+      }
+      if (addr >= ppu::LCDC && addr <= ppu::WX) {
+        video.write(addr, value, clock);
+        if (addr == ppu::DMA)
+          __dma(value);
+        return;
+      }
+      switch (addr) {
+      case P1:
+        if (pad.write(value))
+          request(JOYPAD);
+        break;
+      case SB:
+        link.data = value;
+        break;
+      case SC:
+        link.write_control(value, clock);
+        break;
+      default:
+        io_regs[addr - 0xFF00] = value;
+      }
     } else if (addr < 0xFFFF) {
       hram[addr - 0xFF80] = value;
     } else if (addr == 0xFFFF) {
@@ -85,6 +252,22 @@ struct mmu {
     }
   }
 
+  // the picture is complete once VBlank is raised
+  void __hash_frame() {
+    const u64 memory = hash64(wram0.data(), wram0.size(), 0);
+    hashes->digests.push_back(
+        {video.frames - 1,
+         hash64(video.framebuffer.data(), video.framebuffer.size(), 0),
+         hash64(hram.data(), hram.size(),
+                hash64(wram1.data(), wram1.size(), memory))});
+  }
+
+  // OAM DMA, copied at once instead of over 160 M-cycles
+  void __dma(u8 source) {
+    for (u16 i = 0; i < oam.size(); ++i)
+      oam[i] = at(static_cast<u16>(source << 8 | i));
+  }
+
   // Write a 16-bit value
   void set_u16(u16 addr, u16 value) {
     set_u8(addr, static_cast<u8>(value & 0x00FF));
@@ -92,22 +275,6 @@ struct mmu {
   }
 };
 
-// Sprite structure for OAM (Object Attribute Memory)
-union sprite {
-  u32 data;
-  struct {
-    u8 m_x;
-    u8 m_y;
-    u8 m_tile;
-    bool m_flip;
-  };
-};
-
-// PPU (Picture Processing Unit) OAM table
-struct ppu {
-  std::array<sprite, 40> m_oam;
-};
-
 } // namespace mpu
 
 #endif
@@ -0,0 +1,526 @@
+#include "movie.hpp"
+#include "hash.hpp"
+#include "state_io.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+namespace mpu {
+
+namespace {
+
+constexpr char MAGIC[4] = {'G', 'B', 'M', 'V'};
+constexpr char INDEX_MAGIC[4] = {'G', 'B', 'K', 'I'};
+// 1 had no keyframes, 2 stored snapshots as raw struct bytes and hashed
+// part of the state, 3 included the APU's host-side output state
+constexpr u16 VERSION = 4;
+
+// little-endian output
+struct writer {
+  std::vector<u8> bytes;
+
+  auto u8_(u8 _value) -> void { bytes.push_back(_value); }
+  auto u16_(u16 _value) -> void {
+    for (int i = 0; i < 2; ++i)
+      bytes.push_back(static_cast<u8>(_value >> (8 * i)));
+  }
+  auto u32_(u32 _value) -> void {
+    for (int i = 0; i < 4; ++i)
+      bytes.push_back(static_cast<u8>(_value >> (8 * i)));
+  }
+  auto u64_(u64 _value) -> void {
+    for (int i = 0; i < 8; ++i)
+      bytes.push_back(static_cast<u8>(_value >> (8 * i)));
+  }
+  // LEB128, short runs take a single byte
+  auto varint(u64 _value) -> void {
+    while (_value >= 0x80) {
+      bytes.push_back(static_cast<u8>(_value | 0x80));
+      _value >>= 7;
+    }
+    bytes.push_back(static_cast<u8>(_value));
+  }
+  auto raw(const void *_data, std::size_t _size) -> void {
+    const auto *data = static_cast<const u8 *>(_data);
+    bytes.insert(bytes.end(), data, data + _size);
+  }
+};
+
+// little-endian input, throws on truncated files
+struct reader {
+  const std::vector<u8> &bytes;
+  std::size_t at = 0;
+
+  auto need(std::size_t _size) -> void {
+    if (bytes.size() - at < _size)
+      throw mpu_runtime_error("movie file is truncated");
+  }
+  auto u8_() -> u8 {
+    need(1);
+    return bytes[at++];
+  }
+  auto u16_() -> u16 {
+    need(2);
+    u16 value = 0;
+    for (int i = 0; i < 2; ++i)
+      value |= static_cast<u16>(bytes[at++] << (8 * i));
+    return value;
+  }
+  auto u32_() -> u32 {
+    need(4);
+    u32 value = 0;
+    for (int i = 0; i < 4; ++i)
+      value |= static_cast<u32>(bytes[at++]) << (8 * i);
+    return value;
+  }
+  auto u64_() -> u64 {
+    need(8);
+    u64 value = 0;
+    for (int i = 0; i < 8; ++i)
+      value |= static_cast<u64>(bytes[at++]) << (8 * i);
+    return value;
+  }
+  auto varint() -> u64 {
+    u64 value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const u8 byte = u8_();
+      value |= static_cast<u64>(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    throw mpu_runtime_error("movie file has a bad run length");
+  }
+  auto raw(void *_data, std::size_t _size) -> void {
+    need(_size);
+    std::memcpy(_data, bytes.data() + at, _size);
+    at += _size;
+  }
+};
+
+/*
+ * PackBits: a control byte n < 128 is followed by n + 1 literal bytes,
+ * n >= 128 by one byte repeated n - 125 times. Snapshots are mostly long
+ * runs (cleared RAM, unused tiles), which this shrinks several times over
+ * at memcpy-like speed.
+ */
+auto pack(const u8 *_data, std::size_t _size) -> std::vector<u8> {
+  std::vector<u8> out;
+  out.reserve(_size / 4);
+  std::size_t i = 0;
+  while (i < _size) {
+    std::size_t run = 1;
+    while (i + run < _size && run < 130 && _data[i + run] == _data[i])
+      ++run;
+    if (run >= 3) {
+      out.push_back(static_cast<u8>(run + 125));
+      out.push_back(_data[i]);
+      i += run;
+      continue;
+    }
+
+    // literals until the next run of 3 or 128 bytes
+    std::size_t end = i;
+    while (end < _size && end - i < 128) {
+      if (end + 2 < _size && _data[end] == _data[end + 1] &&
+          _data[end] == _data[end + 2])
+        break;
+      ++end;
+    }
+    out.push_back(static_cast<u8>(end - i - 1));
+    out.insert(out.end(), _data + i, _data + end);
+    i = end;
+  }
+  return out;
+}
+
+auto unpack(const std::vector<u8> &_packed, u8 *_out, std::size_t _size)
+    -> void {
+  std::size_t i = 0;
+  std::size_t o = 0;
+  while (i < _packed.size()) {
+    const u8 control = _packed[i++];
+    if (control < 128) {
+      const std::size_t n = control + 1u;
+      if (i + n > _packed.size() || o + n > _size)
+        throw mpu_runtime_error("corrupt keyframe");
+      std::memcpy(_out + o, _packed.data() + i, n);
+      i += n;
+      o += n;
+    } else {
+      const std::size_t n = control - 125u;
+      if (i >= _packed.size() || o + n > _size)
+        throw mpu_runtime_error("corrupt keyframe");
+      std::memset(_out + o, _packed[i++], n);
+      o += n;
+    }
+  }
+  if (o != _size)
+    throw mpu_runtime_error("corrupt keyframe");
+}
+
+// payload of a keyframe, from memory or from its movie file
+auto payload(const movie &_movie, std::size_t _index) -> std::vector<u8> {
+  const movie::keyframe &key = _movie.keyframes[_index];
+  if (!key.packed.empty())
+    return key.packed;
+
+  std::ifstream file(_movie.path, std::ios::binary);
+  file.seekg(static_cast<std::streamoff>(key.offset));
+  u8 size[4];
+  if (!file.read(reinterpret_cast<char *>(size), sizeof(size)))
+    throw mpu_runtime_error("cannot read keyframe from " + _movie.path);
+  const u32 length = static_cast<u32>(size[0]) | size[1] << 8 |
+                     size[2] << 16 | static_cast<u32>(size[3]) << 24;
+  std::vector<u8> packed(length);
+  if (!file.read(reinterpret_cast<char *>(packed.data()), length))
+    throw mpu_runtime_error("cannot read keyframe from " + _movie.path);
+  return packed;
+}
+
+// the APU catches up lazily; bring it to the bus clock so a state does
+// not depend on when the host last pulled audio
+auto settle(CPU &_cpu) -> void {
+  mmu &bus = _cpu.get_bus();
+  bus.sound.flush(bus.clock);
+}
+
+// _cpu is exactly what loading its ROM into a fresh core gives
+auto at_power_on(CPU &_cpu) -> bool {
+  settle(_cpu);
+  auto fresh = std::make_unique<CPU>();
+  fresh->get_bus().load_rom(_cpu.get_bus().cart.rom());
+  const auto state = std::make_unique<CPU::snapshot>();
+  std::vector<u8> ours, theirs;
+  _cpu.save(*state);
+  encode_state(*state, ours);
+  fresh->save(*state);
+  encode_state(*state, theirs);
+  return ours == theirs;
+}
+
+} // namespace
+
+auto rom_hash(const mmu &_bus) -> u64 {
+  return hash64(_bus.cart.rom().data(), _bus.cart.rom().size(), 0);
+}
+
+auto movie::append(u8 _input) -> void {
+  if (runs.empty() || runs.back().input != _input ||
+      runs.back().frames == ~u32{0})
+    runs.push_back({_input, 0});
+  ++runs.back().frames;
+  ++frames;
+}
+
+auto movie::keyframe_before(u64 _frame) const -> long long {
+  long long found = -1;
+  for (std::size_t i = 0; i < keyframes.size() && keyframes[i].frame <= _frame;
+       ++i)
+    found = static_cast<long long>(i);
+  return found;
+}
+
+auto movie::read_keyframe(std::size_t _index, CPU::snapshot &_state) const
+    -> void {
+  std::vector<u8> encoded(state_size());
+  unpack(payload(*this, _index), encoded.data(), encoded.size());
+  decode_state(encoded.data(), _state);
+}
+
+auto movie::locate(u64 _frame, std::size_t &_run, u32 &_run_frame) const
+    -> void {
+  u64 remaining = _frame;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    if (remaining < runs[i].frames || i + 1 == runs.size()) {
+      _run = i;
+      _run_frame = static_cast<u32>(remaining);
+      return;
+    }
+    remaining -= runs[i].frames;
+  }
+  _run = 0;
+  _run_frame = 0;
+}
+
+/*
+ * "GBMV" u16 version, u8 origin, u64 rom hash, u64 frames, u64 end hash,
+ * [u32 snapshot size, snapshot], u32 run count, runs as (u8 input,
+ * varint frames), keyframe payloads as (u32 size, packed snapshot), then
+ * the index: u32 snapshot size, u32 count, (u64 frame, u64 hash, u64
+ * payload offset) per keyframe, and a trailer of u64 index offset, "GBKI".
+ * Snapshots are in the field encoding of state_io.hpp.
+ */
+auto movie::save(const std::string &_path) const -> void {
+  writer out;
+  // header and start state in one allocation
+  out.bytes.reserve(64 + (start == origin::snapshot ? state_size() : 0));
+  out.raw(MAGIC, sizeof(MAGIC));
+  out.u16_(VERSION);
+  out.u8_(static_cast<u8>(start));
+  out.u64_(rom_hash);
+  out.u64_(frames);
+  out.u64_(end_hash);
+  if (start == origin::snapshot) {
+    out.u32_(static_cast<u32>(state_size()));
+    encode_state(*start_state, out.bytes);
+  }
+  out.u32_(static_cast<u32>(runs.size()));
+  for (const run &r : runs) {
+    out.u8_(r.input);
+    out.varint(r.frames);
+  }
+
+  std::vector<u64> offsets;
+  for (std::size_t i = 0; i < keyframes.size(); ++i) {
+    const std::vector<u8> packed = payload(*this, i);
+    offsets.push_back(out.bytes.size());
+    out.u32_(static_cast<u32>(packed.size()));
+    out.raw(packed.data(), packed.size());
+  }
+
+  const u64 index = out.bytes.size();
+  out.u32_(static_cast<u32>(state_size()));
+  out.u32_(static_cast<u32>(keyframes.size()));
+  for (std::size_t i = 0; i < keyframes.size(); ++i) {
+    out.u64_(keyframes[i].frame);
+    out.u64_(keyframes[i].hash);
+    out.u64_(offsets[i]);
+  }
+  out.u64_(index);
+  out.raw(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+
+  std::ofstream file(_path, std::ios::binary);
+  if (!file.write(reinterpret_cast<const char *>(out.bytes.data()),
+                  static_cast<std::streamsize>(out.bytes.size())))
+    throw mpu_runtime_error("cannot write " + _path);
+}
+
+auto movie::load(const std::string &_path) -> movie {
+  std::ifstream file(_path, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _path);
+  const std::vector<u8> bytes(std::istreambuf_iterator<char>(file), {});
+  reader in{bytes};
+
+  char magic[4];
+  in.raw(magic, sizeof(magic));
+  if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw mpu_runtime_error(_path + " is not a movie");
+  const u16 version = in.u16_();
+  if (version == 0 || version > VERSION)
+    throw mpu_runtime_error(_path + " has an unsupported movie version");
+  // older hashes covered less of the machine and cannot be checked
+  if (version < VERSION)
+    throw mpu_runtime_error(_path + " was recorded by an older build");
+
+  movie result;
+  result.path = _path;
+  result.start = static_cast<origin>(in.u8_());
+  result.rom_hash = in.u64_();
+  const u64 frames = in.u64_();
+  result.end_hash = in.u64_();
+  if (result.start == origin::snapshot) {
+    if (in.u32_() != state_size())
+      throw mpu_runtime_error(_path + " was saved by an incompatible build");
+    in.need(state_size());
+    result.start_state = std::make_unique<CPU::snapshot>();
+    decode_state(bytes.data() + in.at, *result.start_state);
+    in.at += state_size();
+  }
+
+  const u32 count = in.u32_();
+  result.runs.reserve(count);
+  for (u32 i = 0; i < count; ++i) {
+    const u8 input = in.u8_();
+    result.runs.push_back({input, static_cast<u32>(in.varint())});
+    result.frames += result.runs.back().frames;
+  }
+  if (result.frames != frames)
+    throw mpu_runtime_error(_path + " has inconsistent frame counts");
+
+  // keyframe index from the trailer; payloads are read on demand
+  reader tail{bytes, bytes.size() - 12};
+  const u64 index = tail.u64_();
+  char index_magic[4];
+  tail.raw(index_magic, sizeof(index_magic));
+  if (std::memcmp(index_magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+      index > bytes.size())
+    throw mpu_runtime_error(_path + " has no keyframe index");
+
+  reader table{bytes, static_cast<std::size_t>(index)};
+  const u32 snapshot_size = table.u32_();
+  const u32 keys = table.u32_();
+  if (keys && snapshot_size != state_size())
+    throw mpu_runtime_error(_path + " was saved by an incompatible build");
+  result.keyframes.reserve(keys);
+  for (u32 i = 0; i < keys; ++i) {
+    const u64 frame = table.u64_();
+    const u64 hash = table.u64_();
+    const u64 offset = table.u64_();
+    result.keyframes.push_back({frame, hash, offset, {}});
+  }
+  return result;
+}
+
+movie_recorder::movie_recorder(CPU &_cpu, u32 _interval)
+    : m_cpu(_cpu), m_interval(_interval),
+      m_scratch(std::make_unique<CPU::snapshot>()) {
+  m_movie.rom_hash = rom_hash(_cpu.get_bus());
+  // replays start from a bare core with only the ROM loaded; anything else
+  // (a save file, a clock, a core that has run) needs the start state
+  const cartridge &cart = _cpu.get_bus().cart;
+  if (cart.save_attached() || cart.has_rtc() || !at_power_on(_cpu)) {
+    m_movie.start = movie::origin::snapshot;
+    m_movie.start_state = std::make_unique<CPU::snapshot>();
+    settle(_cpu);
+    _cpu.save(*m_movie.start_state);
+  }
+}
+
+auto movie_recorder::record(u8 _input) -> void {
+  const u64 frame = m_movie.frames;
+  if (m_interval && frame && frame % m_interval == 0) {
+    settle(m_cpu);
+    m_cpu.save(*m_scratch);
+    std::vector<u8> encoded;
+    encode_state(*m_scratch, encoded);
+    // machine_hash() of the state, without snapshotting it again
+    m_movie.keyframes.push_back({frame,
+                                 hash64(encoded.data(), encoded.size(), 0), 0,
+                                 pack(encoded.data(), encoded.size())});
+  }
+  m_movie.append(_input);
+}
+
+auto movie_recorder::finish() -> movie & {
+  settle(m_cpu);
+  m_movie.end_hash = machine_hash(m_cpu);
+  return m_movie;
+}
+
+movie_player::movie_player(CPU &_cpu, const movie &_movie)
+    : m_cpu(_cpu), m_movie(_movie) {
+  if (rom_hash(_cpu.get_bus()) != _movie.rom_hash)
+    throw mpu_runtime_error("movie was recorded on a different ROM");
+
+  if (_movie.start == movie::origin::snapshot)
+    _cpu.load(*_movie.start_state);
+  else if (_cpu.get_bus().clock != 0)
+    throw mpu_runtime_error("movie starts at power-on, core has already run");
+
+  // frame 0, for seeks that land before the first keyframe
+  m_origin = std::make_unique<CPU::snapshot>();
+  _cpu.save(*m_origin);
+}
+
+auto movie_player::next() -> u8 {
+  if (done())
+    throw mpu_runtime_error("movie has no more frames");
+  while (m_run_frame == m_movie.runs[m_run].frames) {
+    ++m_run;
+    m_run_frame = 0;
+  }
+  ++m_run_frame;
+  ++m_frame;
+  return m_movie.runs[m_run].input;
+}
+
+auto movie_player::seek(u64 _frame) -> u64 {
+  if (_frame > m_movie.frames)
+    throw mpu_runtime_error("seek past the end of the movie");
+
+  // reload unless we are already between the keyframe and the target
+  const long long key = m_movie.keyframe_before(_frame);
+  const u64 key_frame =
+      key >= 0 ? m_movie.keyframes[static_cast<std::size_t>(key)].frame : 0;
+  if (m_frame > _frame || m_frame < key_frame) {
+    if (key >= 0) {
+      auto state = std::make_unique<CPU::snapshot>();
+      m_movie.read_keyframe(static_cast<std::size_t>(key), *state);
+      m_cpu.load(*state);
+    } else {
+      m_cpu.load(*m_origin);
+    }
+    m_movie.locate(key_frame, m_run, m_run_frame);
+    m_frame = key_frame;
+  }
+
+  const u64 replayed = _frame - m_frame;
+  while (m_frame < _frame) {
+    m_cpu.get_bus().set_input(next());
+    m_cpu.run_frame();
+  }
+  return replayed;
+}
+
+auto movie_player::verify() const -> bool {
+  if (!done())
+    return false;
+  settle(m_cpu);
+  return machine_hash(m_cpu) == m_movie.end_hash;
+}
+
+auto verify_movie(const mmu &_cartridge, const movie &_movie,
+                  unsigned _threads) -> std::vector<movie_segment> {
+  std::vector<movie_segment> segments;
+  u64 first = 0;
+  for (const movie::keyframe &key : _movie.keyframes) {
+    segments.push_back({first, key.frame, key.hash});
+    first = key.frame;
+  }
+  segments.push_back({first, _movie.frames, _movie.end_hash});
+
+  if (_threads == 0)
+    _threads = std::max(1u, std::thread::hardware_concurrency());
+  _threads = std::min<unsigned>(_threads, segments.size());
+
+  // workers pull segments in order, so long movies spread out evenly
+  std::atomic<std::size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::string error;
+
+  auto worker = [&] {
+    try {
+      for (std::size_t i; (i = next.fetch_add(1)) < segments.size();) {
+        movie_segment &segment = segments[i];
+        const auto start = clk::now();
+
+        // a fresh core per segment: the player needs power-on for frame 0
+        auto cpu = std::make_unique<CPU>();
+        cpu->get_bus().load_rom(_cartridge.cart.rom());
+        movie_player player(*cpu, _movie);
+        player.seek(segment.first);
+        while (player.frame() < segment.last) {
+          cpu->get_bus().set_input(player.next());
+          cpu->run_frame();
+        }
+
+        settle(*cpu);
+        segment.actual = machine_hash(*cpu);
+        segment.seconds =
+            std::chrono::duration<double>(clk::now() - start).count();
+      }
+    } catch (std::exception &exception) {
+      if (!failed.exchange(true))
+        error = exception.what();
+      next = segments.size();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < _threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &thread : pool)
+    thread.join();
+
+  if (failed)
+    throw mpu_runtime_error(std::move(error));
+  return segments;
+}
+
+} // namespace mpu
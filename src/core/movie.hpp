@@ -0,0 +1,140 @@
+#ifndef __CORE_MOVIE_HPP
+#define __CORE_MOVIE_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Input movie
+ * @brief the joypad state of every frame of a session, run-length encoded,
+ * plus what it started from: the ROM hash and either power-on or an
+ * embedded snapshot.
+ *
+ * Input is applied once per frame before the frame runs, and the core is
+ * a pure function of its state and input, so a replay reproduces the
+ * session bit for bit; the hash of the final machine state is stored to
+ * prove it.
+ *
+ * Long movies also carry keyframes: a compressed snapshot and state hash
+ * every few hundred frames, indexed at the end of the file. Seeking loads
+ * the nearest keyframe and replays only the remainder; keyframe payloads
+ * stay on disk until one is needed.
+ */
+struct movie {
+  enum class origin : u8 { power_on, snapshot };
+
+  // _frames consecutive frames with the same buttons
+  struct run {
+    u8 input;
+    u32 frames;
+  };
+
+  u64 rom_hash = 0;
+  origin start = origin::power_on;
+  std::unique_ptr<CPU::snapshot> start_state; // with origin::snapshot
+  std::vector<run> runs;
+  u64 frames = 0;
+  u64 end_hash = 0; // machine_hash() after the last frame
+
+  // machine state before `frame` runs
+  struct keyframe {
+    u64 frame;
+    u64 hash;              // machine_hash() of the state
+    u64 offset = 0;        // payload position in `path`, when not in memory
+    std::vector<u8> packed; // compressed CPU::snapshot, empty if on disk
+  };
+  std::vector<keyframe> keyframes; // ascending frames
+  std::string path;                // file the keyframe payloads live in
+
+  auto append(u8 _input) -> void;
+
+  // index of the last keyframe at or before _frame, -1 for none
+  auto keyframe_before(u64 _frame) const -> long long;
+
+  // decompress keyframe _index into _state; safe from several threads
+  auto read_keyframe(std::size_t _index, CPU::snapshot &_state) const -> void;
+
+  // run cursor whose next input is that of _frame
+  auto locate(u64 _frame, std::size_t &_run, u32 &_run_frame) const -> void;
+
+  auto save(const std::string &_path) const -> void;
+  static auto load(const std::string &_path) -> movie;
+};
+
+// identifies the cartridge a movie was recorded on
+auto rom_hash(const mmu &_bus) -> u64;
+
+// builds a movie from a running session; record() once per frame
+struct movie_recorder {
+  constexpr static u32 KEYFRAME_INTERVAL = 600; // about 10 s
+
+  explicit movie_recorder(CPU &_cpu, u32 _interval = KEYFRAME_INTERVAL);
+
+  // input the coming frame runs with
+  auto record(u8 _input) -> void;
+
+  // seal the movie with the hash of the current state
+  auto finish() -> movie &;
+
+private:
+  CPU &m_cpu;
+  u32 m_interval;
+  movie m_movie;
+  std::unique_ptr<CPU::snapshot> m_scratch;
+};
+
+// feeds a movie back; next() once per frame, verify() after the last one
+struct movie_player {
+  movie_player(CPU &_cpu, const movie &_movie);
+
+  auto done() const -> bool { return m_frame == m_movie.frames; }
+  auto frame() const -> u64 { return m_frame; }
+
+  // input for the coming frame
+  auto next() -> u8;
+
+  // jump to just before _frame: load the nearest keyframe and replay the
+  // rest, returns how many frames had to be replayed
+  auto seek(u64 _frame) -> u64;
+
+  // true when the machine ended up exactly where the recording did
+  auto verify() const -> bool;
+
+private:
+  CPU &m_cpu;
+  const movie &m_movie;
+  std::unique_ptr<CPU::snapshot> m_origin;
+  u64 m_frame = 0;
+  std::size_t m_run = 0;
+  u32 m_run_frame = 0;
+};
+
+// outcome of replaying one keyframe-to-keyframe stretch of a movie
+struct movie_segment {
+  u64 first = 0;    // frame the segment starts from (a keyframe or 0)
+  u64 last = 0;     // frame whose state is checked (next keyframe or end)
+  u64 expected = 0; // stored hash at `last`
+  u64 actual = 0;   // hash the replay arrived at
+  double seconds = 0.0;
+
+  auto ok() const -> bool { return expected == actual; }
+};
+
+/**
+ * @brief replay a keyframed movie in parallel: every segment starts from
+ * its own keyframe on one of _threads workers (0: one per core) and must
+ * end on the hash of the next keyframe, or on the end hash for the last.
+ *
+ * _cartridge supplies the ROM; the workers never touch it otherwise.
+ */
+auto verify_movie(const mmu &_cartridge, const movie &_movie,
+                  unsigned _threads = 0) -> std::vector<movie_segment>;
+
+} // namespace mpu
+
+#endif
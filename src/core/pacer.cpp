@@ -0,0 +1,83 @@
+#include "pacer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace mpu {
+
+pacer::pacer(clk::duration _max_spin)
+    : m_max_spin(_max_spin), m_spin(_max_spin), m_overshoot(_max_spin) {
+  restart();
+}
+
+auto pacer::restart() -> void {
+  m_deadline = clk::now();
+  m_last_wake = m_deadline;
+}
+
+auto pacer::wait() -> void {
+  m_deadline += PERIOD;
+  auto now = clk::now();
+
+  if (now > m_deadline + MAX_BEHIND * PERIOD) {
+    ++m_resyncs;
+    restart();
+    return;
+  }
+
+  // the scheduler may overshoot a sleep by a good fraction of a
+  // millisecond, so stop short of the deadline and spin the remainder
+  if (m_deadline - now > m_spin) {
+    const auto wake = m_deadline - m_spin;
+    std::this_thread::sleep_until(wake);
+    now = clk::now();
+    __adapt(now - wake);
+  }
+  while ((now = clk::now()) < m_deadline)
+    std::this_thread::yield();
+
+  __record(now);
+}
+
+// track the worst recent overshoot, forgetting it by 1/16 per frame, and
+// keep twice that plus a little as the spin margin
+auto pacer::__adapt(clk::duration _overshoot) -> void {
+  m_overshoot = std::max(_overshoot, m_overshoot - m_overshoot / 16);
+  m_spin = std::clamp(2 * m_overshoot + std::chrono::microseconds(50),
+                      clk::duration{std::chrono::microseconds(100)},
+                      m_max_spin);
+}
+
+auto pacer::__record(clk::time_point _wake) -> void {
+  using us = std::chrono::duration<double, std::micro>;
+  const double interval = us(_wake - m_last_wake).count();
+  m_last_wake = _wake;
+
+  if (_wake - m_deadline > LATE)
+    ++m_late;
+
+  ++m_frames;
+  const double delta = interval - m_mean;
+  m_mean += delta / static_cast<double>(m_frames);
+  m_m2 += delta * (interval - m_mean);
+  m_worst = std::max(m_worst, std::abs(interval - us(PERIOD).count()));
+}
+
+auto pacer::report() const -> jitter {
+  jitter result;
+  result.frames = m_frames;
+  result.late = m_late;
+  result.resyncs = m_resyncs;
+  result.mean_us = m_mean;
+  result.stddev_us =
+      m_frames > 1 ? std::sqrt(m_m2 / static_cast<double>(m_frames - 1)) : 0.0;
+  result.worst_us = m_worst;
+  return result;
+}
+
+auto pacer::reset_report() -> void {
+  m_frames = m_late = m_resyncs = 0;
+  m_mean = m_m2 = m_worst = 0.0;
+}
+
+} // namespace mpu
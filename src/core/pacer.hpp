@@ -0,0 +1,73 @@
+#ifndef __CORE_PACER_HPP
+#define __CORE_PACER_HPP
+
+#include "apu.hpp"
+#include "common.hpp"
+#include "ppu.hpp"
+#include <chrono>
+
+namespace mpu {
+
+/**
+ * Real-time pacer
+ * @brief holds the emulation to the DMG frame rate (4194304 / 70224, about
+ * 59.73 Hz) against steady_clock, and measures how evenly it does so.
+ *
+ * Each wait() sleeps until shortly before the next frame deadline and
+ * spins for the rest, so the thread costs a few percent of a core while
+ * still waking within microseconds. The spin margin follows the sleep
+ * overshoot actually observed, up to the limit given at construction. A
+ * host that falls more than a few frames behind (debugger, suspend)
+ * resynchronizes instead of racing to catch up.
+ */
+struct pacer {
+  constexpr static clk::duration PERIOD =
+      std::chrono::duration_cast<clk::duration>(std::chrono::nanoseconds(
+          1'000'000'000ull * ppu::FRAME_CYCLES / apu::CLOCK_RATE));
+
+  // frame-time statistics since construction or the last reset
+  struct jitter {
+    u64 frames = 0;
+    u64 late = 0;    // woke more than LATE after the deadline
+    u64 resyncs = 0; // deadlines abandoned after falling too far behind
+    double mean_us = 0.0;   // mean wake-to-wake interval
+    double stddev_us = 0.0; // its standard deviation
+    double worst_us = 0.0;  // largest distance from PERIOD
+  };
+
+  explicit pacer(clk::duration _max_spin = std::chrono::microseconds(2000));
+
+  // block until the next frame is due
+  auto wait() -> void;
+
+  // start counting from now, e.g. after a pause
+  auto restart() -> void;
+
+  auto report() const -> jitter;
+  auto reset_report() -> void;
+
+private:
+  constexpr static u32 MAX_BEHIND = 4; // frames before giving up on catching up
+  constexpr static clk::duration LATE = std::chrono::milliseconds(1);
+
+  clk::duration m_max_spin;
+  clk::duration m_spin;      // current margin left to spin after sleeping
+  clk::duration m_overshoot; // decaying peak of the sleep overshoot
+  clk::time_point m_deadline;
+  clk::time_point m_last_wake;
+
+  // Welford running mean and variance of the interval, in microseconds
+  u64 m_frames = 0;
+  u64 m_late = 0;
+  u64 m_resyncs = 0;
+  double m_mean = 0.0;
+  double m_m2 = 0.0;
+  double m_worst = 0.0;
+
+  auto __adapt(clk::duration _overshoot) -> void;
+  auto __record(clk::time_point _wake) -> void;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,277 @@
+#include "ppu.hpp"
+#include "frame_queue.hpp"
+#include "memory.hpp"
+#include <algorithm>
+
+namespace mpu {
+
+auto ppu::read(u16 _addr) const -> u8 {
+  switch (_addr) {
+  case LCDC:
+    return m_lcdc;
+  case STAT:
+    return 0x80 | (m_stat & 0x78) | (m_ly == m_lyc ? 0x04 : 0) | m_mode;
+  case SCY:
+    return m_scy;
+  case SCX:
+    return m_scx;
+  case LY:
+    return stub_ly ? 0x90 : m_ly;
+  case LYC:
+    return m_lyc;
+  case DMA:
+    return m_dma;
+  case BGP:
+    return m_bgp;
+  case OBP0:
+    return m_obp0;
+  case OBP1:
+    return m_obp1;
+  case WY:
+    return m_wy;
+  case WX:
+    return m_wx;
+  }
+  return 0xFF;
+}
+
+auto ppu::write(u16 _addr, u8 _value, u64 _clock) -> void {
+  switch (_addr) {
+  case LCDC: {
+    const bool was_on = m_lcdc & 0x80;
+    m_lcdc = _value;
+    if (was_on && !(_value & 0x80)) {
+      // LCD off: LY holds at 0 in HBlank until switched back on
+      m_ly = 0;
+      m_mode = HBLANK;
+      m_stat_line = false;
+      next_event = IDLE;
+    } else if (!was_on && (_value & 0x80)) {
+      m_ly = 0;
+      m_window_line = 0;
+      m_mode = OAM_SCAN;
+      next_event = _clock + OAM_CYCLES;
+    }
+  } break;
+  case STAT:
+    m_stat = _value & 0x78;
+    break;
+  case SCY:
+    m_scy = _value;
+    break;
+  case SCX:
+    m_scx = _value;
+    break;
+  case LY:
+    break; // read only
+  case LYC:
+    m_lyc = _value;
+    break;
+  case DMA:
+    m_dma = _value;
+    break;
+  case BGP:
+    m_bgp = _value;
+    break;
+  case OBP0:
+    m_obp0 = _value;
+    break;
+  case OBP1:
+    m_obp1 = _value;
+    break;
+  case WY:
+    m_wy = _value;
+    break;
+  case WX:
+    m_wx = _value;
+    break;
+  }
+}
+
+auto ppu::save(state &_state) const -> void {
+  _state.frames = frames;
+  _state.next_event = next_event;
+  _state.regs = {m_lcdc, m_stat, m_scy,  m_scx,  m_ly, m_lyc,
+                 m_dma,  m_bgp,  m_obp0, m_obp1, m_wy, m_wx};
+  _state.mode = m_mode;
+  _state.window_line = m_window_line;
+  _state.stat_line = m_stat_line;
+}
+
+auto ppu::load(const state &_state) -> void {
+  frames = _state.frames;
+  next_event = _state.next_event;
+  const auto &regs = _state.regs;
+  m_lcdc = regs[0];
+  m_stat = regs[1];
+  m_scy = regs[2];
+  m_scx = regs[3];
+  m_ly = regs[4];
+  m_lyc = regs[5];
+  m_dma = regs[6];
+  m_bgp = regs[7];
+  m_obp0 = regs[8];
+  m_obp1 = regs[9];
+  m_wy = regs[10];
+  m_wx = regs[11];
+  m_mode = _state.mode;
+  m_window_line = _state.window_line;
+  m_stat_line = _state.stat_line;
+}
+
+auto ppu::__advance(u64 _clock, const vram_t &_vram, const oam_t &_oam)
+    -> u8 {
+  u8 requests = 0;
+
+  while (_clock >= next_event) {
+    switch (m_mode) {
+    case OAM_SCAN:
+      m_mode = DRAWING;
+      next_event += DRAWING_CYCLES;
+      break;
+
+    case DRAWING:
+      if (render)
+        __render_line(_vram, _oam);
+      // machine state, so it counts window lines whether drawn or not
+      if (__window_visible())
+        ++m_window_line;
+      m_mode = HBLANK;
+      next_event += LINE_CYCLES - OAM_CYCLES - DRAWING_CYCLES;
+      break;
+
+    case HBLANK:
+      ++m_ly;
+      if (m_ly == HEIGHT) {
+        m_mode = VBLANK;
+        next_event += LINE_CYCLES;
+        requests |= interrupt::VBLANK;
+        __present(next_event - LINE_CYCLES);
+        ++frames;
+      } else {
+        m_mode = OAM_SCAN;
+        next_event += OAM_CYCLES;
+      }
+      break;
+
+    case VBLANK:
+      ++m_ly;
+      if (m_ly == LINES) {
+        m_ly = 0;
+        m_window_line = 0;
+        m_mode = OAM_SCAN;
+        next_event += OAM_CYCLES;
+      } else {
+        next_event += LINE_CYCLES;
+      }
+      break;
+    }
+    requests |= __stat_edge();
+  }
+  return requests;
+}
+
+// hand the finished frame to the output queue, if any
+auto ppu::__present(u64 _clock) -> void {
+  if (!output || !render)
+    return;
+  video_frame &frame = output->back();
+  frame.index = frames;
+  frame.clock = _clock;
+  framebuffer = frame.pixels;
+  output->publish();
+}
+
+// STAT interrupt line, raised on a 0 -> 1 transition only
+auto ppu::__stat_edge() -> u8 {
+  const bool line = ((m_stat & 0x40) && m_ly == m_lyc) ||
+                    ((m_stat & 0x20) && m_mode == OAM_SCAN) ||
+                    ((m_stat & 0x10) && m_mode == VBLANK) ||
+                    ((m_stat & 0x08) && m_mode == HBLANK);
+  const bool rising = line && !m_stat_line;
+  m_stat_line = line;
+  return rising ? interrupt::LCD_STAT : 0;
+}
+
+auto ppu::__render_line(const vram_t &_vram, const oam_t &_oam) -> void {
+  if (m_ly >= HEIGHT)
+    return;
+
+  u8 *target = output ? output->back().pixels.data() : framebuffer.data();
+  u8 *line = target + static_cast<std::size_t>(m_ly) * WIDTH;
+  std::array<u8, WIDTH> colors{}; // BG/window color index, for sprite priority
+
+  // 2bpp tile row lookup; the 0x8800 addressing mode uses signed indices
+  auto tile_pixel = [&](u8 _tile, u8 _row, u8 _column, bool _unsigned) -> u8 {
+    const u16 base = _unsigned ? static_cast<u16>(_tile * 16)
+                               : static_cast<u16>(0x1000 + (int8_t)_tile * 16);
+    const u8 lo = _vram[base + _row * 2];
+    const u8 hi = _vram[base + _row * 2 + 1];
+    const u8 bit = 7 - _column;
+    return static_cast<u8>(((hi >> bit) & 1) << 1 | ((lo >> bit) & 1));
+  };
+
+  const bool unsigned_tiles = m_lcdc & 0x10;
+  if (m_lcdc & 0x01) {
+    const u16 map = (m_lcdc & 0x08) ? 0x1C00 : 0x1800;
+    const u8 y = static_cast<u8>(m_scy + m_ly);
+    for (u32 x = 0; x < WIDTH; ++x) {
+      const u8 bx = static_cast<u8>(m_scx + x);
+      const u8 tile = _vram[map + (y / 8) * 32 + bx / 8];
+      colors[x] = tile_pixel(tile, y % 8, bx % 8, unsigned_tiles);
+    }
+  }
+
+  if (__window_visible()) {
+    const u16 map = (m_lcdc & 0x40) ? 0x1C00 : 0x1800;
+    const int left = m_wx - 7;
+    for (int x = std::max(left, 0); x < static_cast<int>(WIDTH); ++x) {
+      const auto wx = static_cast<u8>(x - left);
+      const u8 tile = _vram[map + (m_window_line / 8) * 32 + wx / 8];
+      colors[x] = tile_pixel(tile, m_window_line % 8, wx % 8, unsigned_tiles);
+    }
+  }
+
+  for (u32 x = 0; x < WIDTH; ++x)
+    line[x] = (m_bgp >> (colors[x] * 2)) & 0x3;
+
+  if (!(m_lcdc & 0x02))
+    return;
+
+  // up to 10 sprites on this line, lower x (then OAM order) wins
+  const u8 height = (m_lcdc & 0x04) ? 16 : 8;
+  std::array<sprite, 10> visible;
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < 40 && count < visible.size(); ++i) {
+    const sprite s{_oam[i * 4], _oam[i * 4 + 1], _oam[i * 4 + 2],
+                   _oam[i * 4 + 3]};
+    const int top = s.m_y - 16;
+    if (m_ly >= top && m_ly < top + height)
+      visible[count++] = s;
+  }
+  std::stable_sort(visible.begin(), visible.begin() + count,
+                   [](const sprite &a, const sprite &b) { return a.m_x < b.m_x; });
+
+  // draw lowest priority first so the winner ends up on top
+  for (std::size_t i = count; i-- > 0;) {
+    const sprite &s = visible[i];
+    u8 row = static_cast<u8>(m_ly - (s.m_y - 16));
+    if (s.m_flags & 0x40)
+      row = height - 1 - row;
+    const u8 tile = height == 16 ? (s.m_tile & 0xFE) : s.m_tile;
+    const u8 palette = (s.m_flags & 0x10) ? m_obp1 : m_obp0;
+
+    for (u8 column = 0; column < 8; ++column) {
+      const int x = s.m_x - 8 + column;
+      if (x < 0 || x >= static_cast<int>(WIDTH))
+        continue;
+      const u8 c = tile_pixel(static_cast<u8>(tile + row / 8), row % 8,
+                              (s.m_flags & 0x20) ? 7 - column : column, true);
+      if (c == 0 || ((s.m_flags & 0x80) && colors[x] != 0))
+        continue;
+      line[x] = (palette >> (c * 2)) & 0x3;
+    }
+  }
+}
+
+} // namespace mpu
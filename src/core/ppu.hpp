@@ -0,0 +1,131 @@
+#ifndef __CORE_PPU_HPP
+#define __CORE_PPU_HPP
+
+#include "common.hpp"
+#include <array>
+
+namespace mpu {
+
+struct frame_queue;
+
+// Sprite structure for OAM (Object Attribute Memory)
+struct sprite {
+  u8 m_y;
+  u8 m_x;
+  u8 m_tile;
+  u8 m_flags;
+};
+
+/**
+ * Picture Processing Unit
+ * @brief LCD timing (modes, LY/LYC, STAT and VBlank interrupts) driven by
+ * scheduled events on the bus clock, plus a scanline renderer.
+ *
+ * Timing always runs; pixel generation can be switched off with `render`
+ * for headless runs, leaving every register and interrupt side effect
+ * unchanged. With an `output` queue attached, lines are drawn straight into
+ * its back buffer and published at VBlank; `framebuffer` then only gets a
+ * copy of each finished frame, for consumers that poll it.
+ */
+struct ppu {
+  constexpr static u32 WIDTH = 160;
+  constexpr static u32 HEIGHT = 144;
+  constexpr static u32 LINE_CYCLES = 456;
+  constexpr static u32 LINES = 154;
+  constexpr static u32 FRAME_CYCLES = LINE_CYCLES * LINES;
+  constexpr static u64 IDLE = ~u64{0};
+
+  constexpr static u16 LCDC = 0xFF40;
+  constexpr static u16 STAT = 0xFF41;
+  constexpr static u16 SCY = 0xFF42;
+  constexpr static u16 SCX = 0xFF43;
+  constexpr static u16 LY = 0xFF44;
+  constexpr static u16 LYC = 0xFF45;
+  constexpr static u16 DMA = 0xFF46;
+  constexpr static u16 BGP = 0xFF47;
+  constexpr static u16 OBP0 = 0xFF48;
+  constexpr static u16 OBP1 = 0xFF49;
+  constexpr static u16 WY = 0xFF4A;
+  constexpr static u16 WX = 0xFF4B;
+
+  // ARGB8888 colors for the four DMG shades
+  constexpr static std::array<u32, 4> PALETTE = {0xFFE0F8D0, 0xFF88C070,
+                                                 0xFF346856, 0xFF081820};
+
+  using vram_t = std::array<u8, 0x2000>;
+  using oam_t = std::array<u8, 0xA0>;
+
+  bool render = true;   // pixel generation switch
+  bool stub_ly = false; // LY always reads 0x90, as gameboy-doctor logs expect
+  std::array<u8, WIDTH * HEIGHT> framebuffer{}; // shade 0-3 per pixel
+  frame_queue *output = nullptr;                // consumer of whole frames
+  u64 frames = 0;        // VBlanks seen so far
+  u64 next_event = 0;    // clock of the next mode change
+
+  auto read(u16 _addr) const -> u8;
+  auto write(u16 _addr, u8 _value, u64 _clock) -> void;
+
+  // registers and timing for snapshots; the framebuffer and output queue
+  // are host side and left alone
+  struct state;
+  auto save(state &_state) const -> void;
+  auto load(const state &_state) -> void;
+
+  // advance to _clock, returns the IF bits to request
+  auto tick(u64 _clock, const vram_t &_vram, const oam_t &_oam) -> u8 {
+    if (_clock < next_event)
+      return 0;
+    return __advance(_clock, _vram, _oam);
+  }
+
+private:
+  enum mode : u8 { HBLANK = 0, VBLANK = 1, OAM_SCAN = 2, DRAWING = 3 };
+  constexpr static u32 OAM_CYCLES = 80;
+  constexpr static u32 DRAWING_CYCLES = 172;
+
+  u8 m_lcdc = 0x91;
+  u8 m_stat = 0;
+  u8 m_scy = 0;
+  u8 m_scx = 0;
+  u8 m_ly = 0;
+  u8 m_lyc = 0;
+  u8 m_dma = 0;
+  u8 m_bgp = 0xFC;
+  u8 m_obp0 = 0xFF;
+  u8 m_obp1 = 0xFF;
+  u8 m_wy = 0;
+  u8 m_wx = 0;
+
+  u8 m_mode = OAM_SCAN;
+  u8 m_window_line = 0;
+  bool m_stat_line = false; // STAT interrupt fires on its rising edge
+
+  auto __advance(u64 _clock, const vram_t &_vram, const oam_t &_oam) -> u8;
+  auto __stat_edge() -> u8;
+  // the window covers part of the current line
+  auto __window_visible() const -> bool {
+    return (m_lcdc & 0x21) == 0x21 && m_wy <= m_ly && m_wx <= 166;
+  }
+  auto __render_line(const vram_t &_vram, const oam_t &_oam) -> void;
+  auto __present(u64 _clock) -> void;
+};
+
+struct ppu::state {
+  u64 frames;
+  u64 next_event;
+  std::array<u8, 12> regs; // LCDC-WX
+  u8 mode;
+  u8 window_line;
+  bool stat_line;
+
+  // members in encoding order, see state_io.hpp
+  template <typename S, typename F>
+  static auto fields(S &_s, F &&_f) -> void {
+    _f(_s.frames, _s.next_event, _s.regs, _s.mode, _s.window_line,
+       _s.stat_line);
+  }
+};
+
+} // namespace mpu
+
+#endif
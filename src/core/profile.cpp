@@ -0,0 +1,114 @@
+#include "profile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+
+namespace mpu {
+
+namespace {
+struct row {
+  std::string_view kind; // "main", "cb" or "pair"
+  u8 first;
+  u8 second;
+  u64 count;
+  u64 cycles;
+};
+
+auto hex(u8 _value) -> std::string {
+  char text[8];
+  std::snprintf(text, sizeof(text), "0x%02x", _value);
+  return text;
+}
+} // namespace
+
+auto opcode_profile::instructions() const -> u64 {
+  u64 total = 0;
+  for (const entry &opcode : m_main)
+    total += opcode.count;
+  return total;
+}
+
+auto opcode_profile::cycles() const -> u64 {
+  u64 total = 0;
+  for (const entry &opcode : m_main)
+    total += opcode.cycles;
+  return total;
+}
+
+auto opcode_profile::clear() -> void {
+  m_main.fill({});
+  m_cb.fill({});
+  std::fill(m_pairs.begin(), m_pairs.end(), 0);
+  m_previous = 0;
+  m_started = false;
+}
+
+auto opcode_profile::save(const std::string &_path) const -> void {
+  std::ofstream file(_path);
+  if (!file)
+    throw mpu_runtime_error("cannot create " + _path);
+
+  // pages one after another, each ranked by count
+  std::vector<row> rows;
+  auto rank = [&rows](std::size_t _first) {
+    std::stable_sort(rows.begin() + static_cast<std::ptrdiff_t>(_first),
+                     rows.end(), [](const row &_a, const row &_b) {
+                       return _a.count > _b.count;
+                     });
+  };
+  for (unsigned i = 0; i < 0x100; ++i)
+    if (m_main[i].count)
+      rows.push_back({"main", static_cast<u8>(i), 0, m_main[i].count,
+                      m_main[i].cycles});
+  rank(0);
+  std::size_t first = rows.size();
+  for (unsigned i = 0; i < 0x100; ++i)
+    if (m_cb[i].count)
+      rows.push_back(
+          {"cb", static_cast<u8>(i), 0, m_cb[i].count, m_cb[i].cycles});
+  rank(first);
+  first = rows.size();
+  for (std::size_t i = 0; i < m_pairs.size(); ++i)
+    if (m_pairs[i])
+      rows.push_back({"pair", static_cast<u8>(i >> 8), static_cast<u8>(i),
+                      m_pairs[i], 0});
+  rank(first);
+
+  if (_path.ends_with(".json")) {
+    file << "{\n  \"instructions\": " << instructions()
+         << ",\n  \"cycles\": " << cycles();
+    for (const char *page : {"main", "cb", "pair"}) {
+      file << ",\n  \"" << (page[0] == 'p' ? "pairs" : page) << "\": [";
+      const char *separator = "\n    ";
+      for (const row &r : rows) {
+        if (r.kind != page)
+          continue;
+        file << separator;
+        separator = ",\n    ";
+        if (r.kind[0] == 'p')
+          file << "{\"first\": \"" << hex(r.first) << "\", \"second\": \""
+               << hex(r.second) << "\", \"count\": " << r.count << "}";
+        else
+          file << "{\"opcode\": \"" << hex(r.first) << "\", \"count\": "
+               << r.count << ", \"cycles\": " << r.cycles << "}";
+      }
+      file << "\n  ]";
+    }
+    file << "\n}\n";
+  } else {
+    file << "kind,opcode,next,count,cycles\n";
+    for (const row &r : rows) {
+      if (r.kind[0] == 'p')
+        file << "pair," << hex(r.first) << "," << hex(r.second) << ","
+             << r.count << ",\n";
+      else
+        file << r.kind << "," << hex(r.first) << ",," << r.count << ","
+             << r.cycles << "\n";
+    }
+  }
+  if (!file.flush())
+    throw mpu_runtime_error("cannot write " + _path);
+}
+
+} // namespace mpu
@@ -0,0 +1,71 @@
+#ifndef __CORE_PROFILE_HPP
+#define __CORE_PROFILE_HPP
+
+#include "common.hpp"
+#include <array>
+#include <string>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Opcode profile
+ * @brief how often each opcode ran and what it cost, for one CPU.
+ *
+ * Counts and T-cycles per unprefixed opcode and per CB-page opcode, plus a
+ * count for every pair of consecutive unprefixed opcodes, the candidates
+ * for dispatch ordering and fused handlers. A CB instruction is counted
+ * under 0xCB on the main page and under its second byte on the CB page.
+ * Filled by CPU::step in GBOY_PROFILE builds only; interrupt dispatch and
+ * halted time are not instructions and are left out.
+ */
+struct opcode_profile {
+  struct entry {
+    u64 count = 0;
+    u64 cycles = 0;
+  };
+
+  opcode_profile() : m_pairs(0x10000) {}
+
+  // one executed instruction; _prefixed is the byte after 0xCB
+  auto record(u8 _opcode, u8 _prefixed, u32 _cycles) -> void {
+    entry &main = m_main[_opcode];
+    ++main.count;
+    main.cycles += _cycles;
+    if (_opcode == 0xCB) {
+      entry &cb = m_cb[_prefixed];
+      ++cb.count;
+      cb.cycles += _cycles;
+    }
+    // the first instruction has no predecessor
+    m_pairs[m_previous << 8 | _opcode] += m_started;
+    m_previous = _opcode;
+    m_started = true;
+  }
+
+  auto main() const -> const std::array<entry, 0x100> & { return m_main; }
+  auto cb() const -> const std::array<entry, 0x100> & { return m_cb; }
+  // times _second directly followed _first
+  auto pair(u8 _first, u8 _second) const -> u64 {
+    return m_pairs[_first << 8 | _second];
+  }
+  // instructions and T-cycles recorded so far
+  auto instructions() const -> u64;
+  auto cycles() const -> u64;
+  auto clear() -> void;
+
+  // JSON when _path ends in .json, CSV otherwise; entries that never ran
+  // are left out and the rest sorted by count
+  auto save(const std::string &_path) const -> void;
+
+private:
+  std::array<entry, 0x100> m_main{};
+  std::array<entry, 0x100> m_cb{};
+  std::vector<u64> m_pairs; // first << 8 | second
+  u32 m_previous = 0;
+  bool m_started = false;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,257 @@
+#include "recorder.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace mpu {
+
+namespace {
+
+// full-range BT.601 (C420jpeg) for each shade of the palette
+struct yuv {
+  u8 y, cb, cr;
+};
+const auto SHADES_YUV = [] {
+  std::array<yuv, 4> table{};
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    const double r = (ppu::PALETTE[i] >> 16) & 0xFF;
+    const double g = (ppu::PALETTE[i] >> 8) & 0xFF;
+    const double b = ppu::PALETTE[i] & 0xFF;
+    auto clamp = [](double _v) {
+      return static_cast<u8>(std::clamp(_v + 0.5, 0.0, 255.0));
+    };
+    table[i] = {clamp(0.299 * r + 0.587 * g + 0.114 * b),
+                clamp(128.0 - 0.168736 * r - 0.331264 * g + 0.5 * b),
+                clamp(128.0 + 0.5 * r - 0.418688 * g - 0.081312 * b)};
+  }
+  return table;
+}();
+
+auto ends_with(const std::string &_text, const char *_suffix) -> bool {
+  const std::size_t n = std::strlen(_suffix);
+  return _text.size() >= n && _text.compare(_text.size() - n, n, _suffix) == 0;
+}
+
+auto put_u16(std::vector<u8> &_out, u16 _value) -> void {
+  _out.push_back(static_cast<u8>(_value));
+  _out.push_back(static_cast<u8>(_value >> 8));
+}
+
+auto put_u32(std::vector<u8> &_out, u32 _value) -> void {
+  put_u16(_out, static_cast<u16>(_value));
+  put_u16(_out, static_cast<u16>(_value >> 16));
+}
+
+} // namespace
+
+auto recorder::format_of(const std::string &_path) -> format {
+  return ends_with(_path, ".rgba") || ends_with(_path, ".raw") ? format::rgba
+                                                               : format::y4m;
+}
+
+auto recorder::sink::open(const std::string &_path) -> void {
+  path = _path;
+  file = std::fopen(_path.c_str(), "wb");
+  if (!file)
+    throw mpu_runtime_error("cannot create " + _path);
+  buffer.reserve(CHUNK);
+}
+
+// keep the first error only, with errno as it is now
+auto recorder::sink::fail(const char *_what) -> void {
+  if (error.empty())
+    error = std::string(_what) + " " + path + ": " + std::strerror(errno);
+}
+
+auto recorder::sink::put(const void *_data, std::size_t _size) -> void {
+  const auto *bytes = static_cast<const u8 *>(_data);
+  offset += _size;
+  if (buffer.size() + _size > CHUNK)
+    flush();
+  buffer.insert(buffer.end(), bytes, bytes + _size);
+}
+
+auto recorder::sink::flush() -> void {
+  if (!buffer.empty() && error.empty() &&
+      std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+    fail("cannot write");
+  buffer.clear();
+}
+
+auto recorder::sink::close() -> void {
+  if (!file)
+    return;
+  flush();
+  if (std::fclose(file) != 0)
+    fail("cannot write");
+  file = nullptr;
+}
+
+recorder::recorder(CPU &_cpu, const std::string &_path, format _format,
+                   bool _audio)
+    : m_cpu(_cpu), m_format(_format),
+      m_queue(QUEUE_DEPTH, frame_queue::policy::backpressure) {
+  m_video.open(_path);
+  if (m_format == format::y4m) {
+    static constexpr char HEADER[] =
+        "YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C420jpeg\n";
+    m_video.put(HEADER, sizeof(HEADER) - 1);
+    m_pixels.resize(ppu::WIDTH * ppu::HEIGHT * 3 / 2);
+  } else {
+    m_index.open(_path + ".idx");
+    m_pixels.resize(ppu::WIDTH * ppu::HEIGHT * 4);
+  }
+
+  mmu &bus = m_cpu.get_bus();
+  if (_audio) {
+    m_audio.open(_path + ".wav");
+    m_audio_rate = bus.sound.output_rate();
+    __wav_header(); // placeholder sizes, rewritten on close
+    m_tap = std::make_unique<apu::tap_ring>();
+    bus.sound.tap = m_tap.get();
+  }
+
+  bus.video.output = &m_queue;
+  m_writer = std::thread(&recorder::__run, this);
+}
+
+recorder::~recorder() {
+  try {
+    stop();
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+  }
+}
+
+auto recorder::stop() -> void {
+  if (m_stopped)
+    return;
+  m_stopped = true;
+  mmu &bus = m_cpu.get_bus();
+  bus.video.output = nullptr;
+  bus.sound.tap = nullptr;
+
+  m_stop.store(true, std::memory_order_release);
+  m_writer.join();
+
+  m_video.close();
+  m_index.close();
+  if (m_audio.file) {
+    m_audio.flush();
+    if (std::fseek(m_audio.file, 0, SEEK_SET) != 0)
+      m_audio.fail("cannot rewind");
+    __wav_header();
+    m_audio.close();
+  }
+
+  for (const sink *out : {&m_video, &m_index, &m_audio})
+    if (!out->error.empty())
+      throw mpu_runtime_error(std::string(out->error));
+}
+
+auto recorder::__run() -> void {
+  while (!m_stop.load(std::memory_order_acquire)) {
+    if (!__drain())
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  while (__drain()) {
+  }
+}
+
+// write whatever is queued, false if there was nothing
+auto recorder::__drain() -> bool {
+  bool busy = false;
+  while (const video_frame *frame = m_queue.acquire()) {
+    __write_frame(*frame);
+    busy = true;
+  }
+
+  if (m_tap) {
+    while (const audio_block *block = m_tap->read_slot()) {
+      m_audio.put(block->samples.data(), sizeof(block->samples));
+      m_audio_frames += audio_block::FRAMES;
+      m_tap->release();
+      busy = true;
+    }
+  }
+  return busy;
+}
+
+auto recorder::__write_frame(const video_frame &_frame) -> void {
+  const auto &shades = _frame.pixels;
+
+  if (m_format == format::y4m) {
+    static constexpr char FRAME[] = "FRAME\n";
+    u8 *y = m_pixels.data();
+    u8 *cb = y + ppu::WIDTH * ppu::HEIGHT;
+    u8 *cr = cb + ppu::WIDTH * ppu::HEIGHT / 4;
+    for (std::size_t i = 0; i < shades.size(); ++i)
+      y[i] = SHADES_YUV[shades[i]].y;
+
+    // chroma: average of each 2x2 block
+    for (u32 row = 0; row < ppu::HEIGHT; row += 2) {
+      for (u32 column = 0; column < ppu::WIDTH; column += 2) {
+        const std::size_t at = row * ppu::WIDTH + column;
+        const std::array<u8, 4> quad = {shades[at], shades[at + 1],
+                                        shades[at + ppu::WIDTH],
+                                        shades[at + ppu::WIDTH + 1]};
+        u32 u = 2, v = 2; // rounding
+        for (const u8 shade : quad) {
+          u += SHADES_YUV[shade].cb;
+          v += SHADES_YUV[shade].cr;
+        }
+        *cb++ = static_cast<u8>(u / 4);
+        *cr++ = static_cast<u8>(v / 4);
+      }
+    }
+    m_video.put(FRAME, sizeof(FRAME) - 1);
+  } else {
+    u8 *out = m_pixels.data();
+    for (const u8 shade : shades) {
+      const u32 argb = ppu::PALETTE[shade];
+      *out++ = static_cast<u8>(argb >> 16);
+      *out++ = static_cast<u8>(argb >> 8);
+      *out++ = static_cast<u8>(argb);
+      *out++ = static_cast<u8>(argb >> 24);
+    }
+
+    const std::string line = std::to_string(_frame.index) + " " +
+                             std::to_string(_frame.clock) + " " +
+                             std::to_string(m_video.offset) + "\n";
+    m_index.put(line.data(), line.size());
+  }
+
+  m_video.put(m_pixels.data(), m_pixels.size());
+  m_frames_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+// RIFF/WAVE header for 32-bit float stereo
+auto recorder::__wav_header() -> void {
+  constexpr u16 CHANNELS = 2;
+  constexpr u16 BITS = 32;
+  const auto data = static_cast<u32>(m_audio_frames * CHANNELS * BITS / 8);
+
+  std::vector<u8> header;
+  header.reserve(44);
+  header.insert(header.end(), {'R', 'I', 'F', 'F'});
+  put_u32(header, 36 + data);
+  header.insert(header.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+  put_u32(header, 16);
+  put_u16(header, 3); // IEEE float
+  put_u16(header, CHANNELS);
+  put_u32(header, m_audio_rate);
+  put_u32(header, m_audio_rate * CHANNELS * BITS / 8);
+  put_u16(header, CHANNELS * BITS / 8);
+  put_u16(header, BITS);
+  header.insert(header.end(), {'d', 'a', 't', 'a'});
+  put_u32(header, data);
+
+  if (m_audio.error.empty() &&
+      std::fwrite(header.data(), 1, header.size(), m_audio.file) !=
+          header.size())
+    m_audio.fail("cannot write");
+}
+
+} // namespace mpu
@@ -0,0 +1,102 @@
+#ifndef __CORE_RECORDER_HPP
+#define __CORE_RECORDER_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include "frame_queue.hpp"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Video recorder
+ * @brief streams every rendered frame (and optionally the audio) to disk
+ * from a background thread, so the emulation thread never touches a file.
+ *
+ * The PPU draws straight into the recorder's frame queue, whose
+ * preallocated buffers are the pool; the queue applies backpressure
+ * rather than losing frames when the disk falls behind. The writer packs
+ * frames into a large buffer and writes it out in big sequential chunks.
+ *
+ * Formats: Y4M (4:2:0, 4194304/70224 fps) playable by ffmpeg and mpv, or
+ * raw RGBA frames with a `.idx` text index of frame number, bus clock and
+ * byte offset. With audio on, a 32-bit float WAV goes next to the video.
+ *
+ * Attach and detach (construct and destroy) while the core is not running.
+ * The first failed write is kept and reported by stop(); the files are
+ * left as far as they got.
+ */
+struct recorder {
+  enum class format : u8 { y4m, rgba };
+
+  recorder(CPU &_cpu, const std::string &_path, format _format = format::y4m,
+           bool _audio = false);
+  ~recorder();
+
+  recorder(const recorder &) = delete;
+  recorder &operator=(const recorder &) = delete;
+
+  // detach, write out what is queued and close the files; throws if any
+  // write failed. The destructor does the same, printing the error instead.
+  auto stop() -> void;
+
+  auto frames_written() const -> u64 {
+    return m_frames_written.load(std::memory_order_relaxed);
+  }
+
+  // pick the format from the file extension, .rgba or .raw for raw frames
+  static auto format_of(const std::string &_path) -> format;
+
+private:
+  constexpr static std::size_t QUEUE_DEPTH = 8;
+  constexpr static std::size_t CHUNK = 4 << 20; // bytes per write
+
+  // buffered sequential output file; after the first failure it only
+  // keeps the error and stops writing
+  struct sink {
+    std::FILE *file = nullptr;
+    std::string path;
+    std::string error;
+    std::vector<u8> buffer;
+    u64 offset = 0; // bytes handed to put() so far
+
+    ~sink() { close(); }
+
+    auto open(const std::string &_path) -> void;
+    auto put(const void *_data, std::size_t _size) -> void;
+    auto flush() -> void;
+    auto close() -> void;
+    auto fail(const char *_what) -> void;
+  };
+
+  CPU &m_cpu;
+  format m_format;
+  frame_queue m_queue;
+  std::unique_ptr<apu::tap_ring> m_tap;
+
+  sink m_video;
+  sink m_index;
+  sink m_audio;
+  u64 m_audio_frames = 0;
+  u32 m_audio_rate = 0;
+
+  std::vector<u8> m_pixels; // one converted frame
+  std::atomic<bool> m_stop{false};
+  bool m_stopped = false;
+  std::atomic<u64> m_frames_written{0};
+  std::thread m_writer;
+
+  auto __run() -> void;
+  auto __drain() -> bool;
+  auto __write_frame(const video_frame &_frame) -> void;
+  auto __wav_header() -> void;
+};
+
+} // namespace mpu
+
+#endif
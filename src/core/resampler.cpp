@@ -0,0 +1,157 @@
+#include "resampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GBOY_X86 1
+#include <immintrin.h>
+#endif
+
+namespace mpu {
+
+namespace {
+
+auto dot_scalar(const float *_taps, const float *_left, const float *_right,
+                float *_out) -> void {
+  float left = 0.0f;
+  float right = 0.0f;
+  for (u32 k = 0; k < resampler::TAPS; ++k) {
+    left += _taps[k] * _left[k];
+    right += _taps[k] * _right[k];
+  }
+  _out[0] = left;
+  _out[1] = right;
+}
+
+#ifdef GBOY_X86
+auto hsum(__m128 _v) -> float {
+  const __m128 high = _mm_movehl_ps(_v, _v);
+  const __m128 pair = _mm_add_ps(_v, high);
+  return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 0x1)));
+}
+
+auto dot_sse2(const float *_taps, const float *_left, const float *_right,
+              float *_out) -> void {
+  __m128 left = _mm_setzero_ps();
+  __m128 right = _mm_setzero_ps();
+  for (u32 k = 0; k < resampler::TAPS; k += 4) {
+    const __m128 taps = _mm_loadu_ps(_taps + k);
+    left = _mm_add_ps(left, _mm_mul_ps(taps, _mm_loadu_ps(_left + k)));
+    right = _mm_add_ps(right, _mm_mul_ps(taps, _mm_loadu_ps(_right + k)));
+  }
+  _out[0] = hsum(left);
+  _out[1] = hsum(right);
+}
+
+[[gnu::target("avx2,fma")]] auto dot_avx2(const float *_taps,
+                                          const float *_left,
+                                          const float *_right, float *_out)
+    -> void {
+  __m256 left = _mm256_setzero_ps();
+  __m256 right = _mm256_setzero_ps();
+  for (u32 k = 0; k < resampler::TAPS; k += 8) {
+    const __m256 taps = _mm256_loadu_ps(_taps + k);
+    left = _mm256_fmadd_ps(taps, _mm256_loadu_ps(_left + k), left);
+    right = _mm256_fmadd_ps(taps, _mm256_loadu_ps(_right + k), right);
+  }
+  // left in the low half, right in the high half, then fold to 2 lanes
+  const __m256 pairs = _mm256_hadd_ps(left, right);
+  const __m128 folded = _mm_add_ps(_mm256_castps256_ps128(pairs),
+                                   _mm256_extractf128_ps(pairs, 1));
+  const __m128 sums = _mm_hadd_ps(folded, folded);
+  _out[0] = _mm_cvtss_f32(sums);
+  _out[1] = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, 0x1));
+}
+#endif
+
+} // namespace
+
+resampler::resampler(u32 _in_rate, u32 _out_rate, isa _isa)
+    : m_isa(_isa), m_step((static_cast<u64>(_in_rate) << 32) / _out_rate),
+      m_in_rate(_in_rate), m_out_rate(_out_rate),
+      m_taps(static_cast<std::size_t>(PHASES) * TAPS) {
+  // low-pass just under the lower of the two Nyquist frequencies
+  const double cutoff =
+      0.46 * std::min(1.0, static_cast<double>(_out_rate) / _in_rate);
+
+  for (u32 phase = 0; phase < PHASES; ++phase) {
+    const double frac = static_cast<double>(phase) / PHASES;
+    float *taps = &m_taps[static_cast<std::size_t>(phase) * TAPS];
+    double sum = 0.0;
+
+    for (u32 k = 0; k < TAPS; ++k) {
+      const double x = static_cast<double>(k) - (TAPS / 2.0 - 1.0) - frac;
+      const double arg = 2.0 * std::numbers::pi * cutoff * x;
+      const double sinc = x == 0.0 ? 1.0 : std::sin(arg) / arg;
+      const double w = (x + TAPS / 2.0) / TAPS;
+      const double window = 0.42 - 0.5 * std::cos(2.0 * std::numbers::pi * w) +
+                            0.08 * std::cos(4.0 * std::numbers::pi * w);
+      taps[k] = static_cast<float>(sinc * window);
+      sum += taps[k];
+    }
+    for (u32 k = 0; k < TAPS; ++k)
+      taps[k] = static_cast<float>(taps[k] / sum);
+  }
+
+  for (auto &history : m_history)
+    history.assign(TAPS + 2 * MAX_CHUNK, 0.0f);
+  m_filled = TAPS;
+
+  m_dot = dot_scalar;
+  if (m_isa == isa::scalar)
+    return;
+#ifdef GBOY_X86
+  const bool avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (avx2 && (m_isa == isa::avx2 || m_isa == isa::best)) {
+    m_isa = isa::avx2;
+    m_dot = dot_avx2;
+    return;
+  }
+  m_isa = isa::sse2;
+  m_dot = dot_sse2;
+#else
+  m_isa = isa::scalar;
+#endif
+}
+
+auto resampler::process(const float *_in, u32 _frames, float *_out,
+                        u32 _capacity) -> u32 {
+  _frames = std::min(_frames, MAX_CHUNK);
+  for (u32 i = 0; i < _frames; ++i) {
+    m_history[0][m_filled + i] = _in[i * 2];
+    m_history[1][m_filled + i] = _in[i * 2 + 1];
+  }
+  m_filled += _frames;
+
+  u32 written = 0;
+  while (written < _capacity) {
+    const auto index = static_cast<u32>(m_pos >> 32);
+    if (index + TAPS > m_filled)
+      break;
+    const auto phase = static_cast<u32>(((m_pos & 0xFFFFFFFF) * PHASES) >> 32);
+    m_dot(&m_taps[static_cast<std::size_t>(phase) * TAPS],
+          &m_history[0][index], &m_history[1][index], _out + written * 2);
+    ++written;
+    m_pos += m_step;
+  }
+
+  // keep only the frames later outputs still reach
+  const auto consumed = std::min(static_cast<u32>(m_pos >> 32), m_filled);
+  for (auto &history : m_history)
+    std::copy(history.begin() + consumed, history.begin() + m_filled,
+              history.begin());
+  m_filled -= consumed;
+  m_pos -= static_cast<u64>(consumed) << 32;
+  return written;
+}
+
+auto resampler::max_output(u32 _frames) const -> u32 {
+  return static_cast<u32>(
+             (static_cast<u64>(_frames) * m_out_rate + m_in_rate - 1) /
+             m_in_rate) +
+         1;
+}
+
+} // namespace mpu
@@ -0,0 +1,59 @@
+#ifndef __CORE_RESAMPLER_HPP
+#define __CORE_RESAMPLER_HPP
+
+#include "common.hpp"
+#include <array>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Polyphase windowed-sinc resampler for interleaved stereo
+ * @brief converts the APU's native rate to the host output rate.
+ *
+ * Every output frame is a TAPS-long dot product of the input history with
+ * the nearest of PHASES precomputed filter phases. Both channels share the
+ * coefficient loads; the dot product runs on AVX2+FMA or SSE2 when the host
+ * has them (picked at runtime), with a scalar fallback elsewhere.
+ */
+struct resampler {
+  constexpr static u32 TAPS = 32;
+  constexpr static u32 PHASES = 256;
+  constexpr static u32 MAX_CHUNK = 1024; // input frames per process() call
+
+  enum class isa : u8 { scalar, sse2, avx2, best };
+
+  resampler(u32 _in_rate, u32 _out_rate, isa _isa = isa::best);
+
+  // consume _frames input frames (at most MAX_CHUNK), writing up to
+  // _capacity output frames, which should be at least max_output(_frames);
+  // returns the number of frames written
+  auto process(const float *_in, u32 _frames, float *_out, u32 _capacity)
+      -> u32;
+
+  // output frames produced for _frames input frames, rounded up
+  auto max_output(u32 _frames) const -> u32;
+
+  auto kernel() const -> isa { return m_isa; }
+
+  using dot_fn = void (*)(const float *_taps, const float *_left,
+                          const float *_right, float *_out);
+
+private:
+  isa m_isa;
+  dot_fn m_dot;
+  u64 m_step;    // input frames per output frame, 32.32 fixed point
+  u64 m_pos = 0; // next output position in the history, 32.32 fixed point
+  u32 m_in_rate;
+  u32 m_out_rate;
+
+  // PHASES x TAPS filter coefficients
+  std::vector<float> m_taps;
+  // planar input history: TAPS frames of context followed by new input
+  std::array<std::vector<float>, 2> m_history;
+  u32 m_filled = 0;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __CORE_RING_HPP
+#define __CORE_RING_HPP
+
+#include "common.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace mpu {
+
+/**
+ * Single-producer/single-consumer ring of preallocated slots
+ * @brief lock-free handoff between the emulation thread and one consumer.
+ *
+ * Slots are filled and drained in place: the producer writes into
+ * write_slot() and publishes it, the consumer reads read_slot() and
+ * releases it, so nothing is copied or allocated after construction.
+ */
+template <typename T, std::size_t N> struct spsc_ring {
+  static_assert(std::has_single_bit(N), "ring capacity must be a power of 2");
+
+  // producer side: free slot to fill, nullptr while the ring is full
+  auto write_slot() -> T * {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head_cache == N) {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      if (tail - m_head_cache == N)
+        return nullptr;
+    }
+    return &m_slots[tail & (N - 1)];
+  }
+
+  // producer side: hand the slot returned by write_slot() to the consumer
+  auto publish() -> void {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // consumer side: oldest published slot, nullptr while the ring is empty
+  auto read_slot() -> T * {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail_cache) {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (head == m_tail_cache)
+        return nullptr;
+    }
+    return &m_slots[head & (N - 1)];
+  }
+
+  // consumer side: give the slot returned by read_slot() back to the producer
+  auto release() -> void {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  // approximate number of published slots, exact from either thread's view
+  // of its own index
+  auto size() const -> std::size_t {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+
+  constexpr static auto capacity() -> std::size_t { return N; }
+
+private:
+  // indices grow forever and are masked on access, each side caches the
+  // other's index to keep the shared cache lines quiet
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  std::size_t m_tail_cache = 0;
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+  std::size_t m_head_cache = 0;
+  alignas(64) std::array<T, N> m_slots{};
+};
+
+} // namespace mpu
+
+#endif
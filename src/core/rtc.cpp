@@ -0,0 +1,73 @@
+#include "rtc.hpp"
+
+namespace mpu {
+
+auto rtc::write(u8 _reg, u8 _value, u64 _clock) -> void {
+  __fold(_clock);
+  u64 days = seconds / DAY;
+  u64 hours = seconds / 3600 % 24;
+  u64 minutes = seconds / 60 % 60;
+  u64 secs = seconds % 60;
+
+  switch (_reg) {
+  case S:
+    secs = _value & 0x3F;
+    since = _clock; // restarts the sub-second divider
+    break;
+  case M:
+    minutes = _value & 0x3F;
+    break;
+  case H:
+    hours = _value & 0x1F;
+    break;
+  case DL:
+    days = (days & 0x100) | _value;
+    break;
+  case DH:
+    days = (days & 0xFF) | (_value & 0x01) << 8;
+    carry = _value & 0x80;
+    if (halted && !(_value & 0x40))
+      since = _clock; // resumes counting from now
+    halted = _value & 0x40;
+    break;
+  default:
+    return;
+  }
+  seconds = (((days * 24 + hours) * 60 + minutes) * 60 + secs) % WRAP;
+}
+
+auto rtc::latch(u8 _value, u64 _clock) -> void {
+  if (armed && _value == 1)
+    latched = registers(_clock);
+  armed = _value == 0;
+}
+
+auto rtc::registers(u64 _clock) -> std::array<u8, 5> {
+  __fold(_clock);
+  const u64 days = seconds / DAY;
+  return {static_cast<u8>(seconds % 60), static_cast<u8>(seconds / 60 % 60),
+          static_cast<u8>(seconds / 3600 % 24), static_cast<u8>(days & 0xFF),
+          static_cast<u8>((days >> 8 & 0x01) | (halted ? 0x40 : 0) |
+                          (carry ? 0x80 : 0))};
+}
+
+auto rtc::advance(u64 _seconds) -> void {
+  if (halted)
+    return;
+  seconds += _seconds;
+  if (seconds >= WRAP) {
+    carry = true;
+    seconds %= WRAP;
+  }
+}
+
+// account for the whole seconds since `since`; the remainder stays pending
+auto rtc::__fold(u64 _clock) -> void {
+  if (halted || _clock <= since)
+    return;
+  const u64 elapsed = (_clock - since) / CLOCK;
+  since += elapsed * CLOCK;
+  advance(elapsed);
+}
+
+} // namespace mpu
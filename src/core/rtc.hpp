@@ -0,0 +1,63 @@
+#ifndef __CORE_RTC_HPP
+#define __CORE_RTC_HPP
+
+#include "common.hpp"
+#include <array>
+
+namespace mpu {
+
+/**
+ * MBC3 real-time clock
+ * @brief seconds/minutes/hours/9-bit days counter with halt and day carry,
+ * derived from the bus clock on demand instead of ticking.
+ *
+ * The counter is kept as a second count at a reference bus clock; it is
+ * only folded forward when the game latches or writes a register, so a
+ * running clock costs nothing per instruction. Being guest-timed, it is
+ * deterministic and rolls back with snapshots. advance() adds host time,
+ * for catching up on the time a save spent on disk.
+ *
+ * Register writes are stored as one second count, so out-of-range values
+ * (e.g. 61 seconds) carry into the next field instead of counting on to 63
+ * and wrapping as the chip does.
+ */
+struct rtc {
+  constexpr static u64 CLOCK = 4194304; // T-cycles per second
+  constexpr static u64 DAY = 24 * 60 * 60;
+  constexpr static u64 WRAP = 512 * DAY; // day counter overflow
+
+  // register numbers as selected through the MBC3 RAM bank register
+  enum reg : u8 { S = 0x08, M = 0x09, H = 0x0A, DL = 0x0B, DH = 0x0C };
+
+  u64 seconds = 0;    // counter value at `since`, below WRAP
+  u64 since = 0;      // bus clock `seconds` was taken at
+  bool halted = false;
+  bool carry = false; // day counter overflowed, sticky
+  bool armed = false; // 0 written to the latch register
+  std::array<u8, 5> latched{}; // S, M, H, DL, DH as the game reads them
+
+  auto read(u8 _reg) const -> u8 { return latched[_reg - S]; }
+  auto write(u8 _reg, u8 _value, u64 _clock) -> void;
+
+  // 0x6000-7FFF: writing 0 then 1 copies the counter into `latched`
+  auto latch(u8 _value, u64 _clock) -> void;
+
+  // S, M, H, DL, DH of the running counter at _clock
+  auto registers(u64 _clock) -> std::array<u8, 5>;
+
+  // move a stopped-in-time counter on by host seconds, unless halted
+  auto advance(u64 _seconds) -> void;
+
+  // members in encoding order, see state_io.hpp
+  template <typename S, typename F>
+  static auto fields(S &_s, F &&_f) -> void {
+    _f(_s.seconds, _s.since, _s.halted, _s.carry, _s.armed, _s.latched);
+  }
+
+private:
+  auto __fold(u64 _clock) -> void;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,68 @@
+#include "run_ahead.hpp"
+
+namespace mpu {
+
+auto run_ahead::stats::overhead() const -> double {
+  if (real.count() == 0)
+    return 0.0;
+  return static_cast<double>(extra.count()) /
+         static_cast<double>(real.count());
+}
+
+auto run_ahead::stats::extra_per_frame() const -> clk::duration {
+  if (frames == 0)
+    return {};
+  return extra / static_cast<clk::rep>(frames);
+}
+
+run_ahead::run_ahead(CPU &_cpu, u32 _frames)
+    : m_cpu(_cpu), m_frames(_frames),
+      m_snapshot(std::make_unique<CPU::snapshot>()) {}
+
+auto run_ahead::frame() -> void {
+  if (m_frames == 0) {
+    m_cpu.run_frame();
+    return;
+  }
+
+  mmu &bus = m_cpu.get_bus();
+  const bool audio = bus.sound.synthesis();
+  const bool video = bus.video.render;
+  const auto start = clk::now();
+
+  // the real frame: heard but never seen
+  m_cpu.set_video_enabled(false);
+  m_cpu.run_frame();
+  bus.sound.flush(bus.clock);
+  const auto real = clk::now();
+
+  // nothing outside the machine may see the speculative frames: no frame
+  // hashes, no link partner, no writes to the save file and no trace,
+  // profile or PC samples
+  frame_hashes *const hashes = bus.hashes;
+  serial *const peer = bus.link.peer;
+  const bool recording = m_cpu.recording();
+  m_cpu.save(*m_snapshot);
+  bus.hashes = nullptr;
+  bus.link.peer = nullptr;
+  bus.cart.set_scratch(true);
+  m_cpu.set_recording(false);
+  m_cpu.set_audio_enabled(false);
+  for (u32 i = 1; i <= m_frames; ++i) {
+    m_cpu.set_video_enabled(video && i == m_frames);
+    m_cpu.run_frame();
+  }
+  m_cpu.load(*m_snapshot);
+  bus.cart.set_scratch(false);
+  bus.link.peer = peer;
+  bus.hashes = hashes;
+  m_cpu.set_recording(recording);
+  m_cpu.set_audio_enabled(audio);
+  m_cpu.set_video_enabled(video);
+
+  ++m_stats.frames;
+  m_stats.real += real - start;
+  m_stats.extra += clk::now() - real;
+}
+
+} // namespace mpu
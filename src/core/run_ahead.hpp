@@ -0,0 +1,53 @@
+#ifndef __CORE_RUN_AHEAD_HPP
+#define __CORE_RUN_AHEAD_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include <memory>
+
+namespace mpu {
+
+/**
+ * Run-ahead
+ * @brief hides the lag of the game's own input polling: every host frame
+ * emulates the real frame, snapshots, emulates `frames` more with the
+ * current input, shows the last of them and rolls back to the snapshot.
+ *
+ * Only the real frame produces audio, and only the shown speculative frame
+ * generates pixels (into the framebuffer or the PPU's output queue). The
+ * speculative frames run detached from frame hashes, the link partner and
+ * the save file, with trace, profile and PC sampling off.
+ */
+struct run_ahead {
+  // time spent per host frame, to see what the extra frames cost
+  struct stats {
+    u64 frames = 0;
+    clk::duration real{};  // emulating the real frames
+    clk::duration extra{}; // snapshot, speculative frames and rollback
+
+    // extra time relative to the real frame, 1.0 doubles the CPU cost
+    auto overhead() const -> double;
+    auto extra_per_frame() const -> clk::duration;
+  };
+
+  explicit run_ahead(CPU &_cpu, u32 _frames = 1);
+
+  // emulate one host frame
+  auto frame() -> void;
+
+  auto set_frames(u32 _frames) -> void { m_frames = _frames; }
+  auto frames() const -> u32 { return m_frames; }
+
+  auto statistics() const -> const stats & { return m_stats; }
+  auto reset_statistics() -> void { m_stats = {}; }
+
+private:
+  CPU &m_cpu;
+  u32 m_frames;
+  std::unique_ptr<CPU::snapshot> m_snapshot;
+  stats m_stats;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,70 @@
+#include "sampler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace mpu {
+
+namespace {
+constexpr const char *HEADER = "# gboy pc samples, interval %u";
+} // namespace
+
+auto pc_sampler::histogram() const -> std::vector<sample> {
+  std::vector<sample> samples;
+  samples.reserve(m_counts.size());
+  for (const auto &[at, count] : m_counts)
+    samples.push_back(
+        {static_cast<u16>(at >> 16), static_cast<u16>(at), count});
+  std::sort(samples.begin(), samples.end(),
+            [](const sample &_a, const sample &_b) {
+              if (_a.count != _b.count)
+                return _a.count > _b.count;
+              return _a.bank != _b.bank ? _a.bank < _b.bank : _a.pc < _b.pc;
+            });
+  return samples;
+}
+
+auto pc_sampler::save(const std::string &_path) const -> void {
+  std::ofstream file(_path);
+  if (!file)
+    throw mpu_runtime_error("cannot create " + _path);
+
+  char line[48];
+  std::snprintf(line, sizeof(line), HEADER, m_interval);
+  file << line << "\n";
+  for (const sample &at : histogram()) {
+    std::snprintf(line, sizeof(line), "%02x:%04x %llu\n", at.bank, at.pc,
+                  static_cast<unsigned long long>(at.count));
+    file << line;
+  }
+  if (!file.flush())
+    throw mpu_runtime_error("cannot write " + _path);
+}
+
+auto pc_sampler::load(const std::string &_path, u32 &_interval)
+    -> std::vector<sample> {
+  std::ifstream file(_path);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _path);
+
+  std::string line;
+  if (!std::getline(file, line) ||
+      std::sscanf(line.c_str(), HEADER, &_interval) != 1)
+    throw mpu_runtime_error(_path + ": not a gboy pc sample file");
+
+  std::vector<sample> samples;
+  std::size_t number = 1;
+  while (std::getline(file, line)) {
+    ++number;
+    unsigned bank, pc;
+    unsigned long long count;
+    if (std::sscanf(line.c_str(), "%x:%x %llu", &bank, &pc, &count) != 3)
+      throw mpu_runtime_error(_path + ":" + std::to_string(number) +
+                              ": expected bank:pc count");
+    samples.push_back(
+        {static_cast<u16>(bank), static_cast<u16>(pc), count});
+  }
+  return samples;
+}
+
+} // namespace mpu
@@ -0,0 +1,74 @@
+#ifndef __CORE_SAMPLER_HPP
+#define __CORE_SAMPLER_HPP
+
+#include "common.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Guest PC sampler
+ * @brief histogram of where one CPU spends guest time.
+ *
+ * Every interval() T-cycles CPU::step records the bank:pc it is about to
+ * run, or is halted at. A step covering several intervals (a halt skipping
+ * ahead to the next event) counts once per interval, so samples stay
+ * proportional to guest time. Due times follow the bus clock, and
+ * CPU::load restarts them at the loaded clock, so a seek is not counted as
+ * one long stay at a single pc. While stopped, step() pays one compare
+ * against a clock that never comes.
+ */
+struct pc_sampler {
+  constexpr static u64 NEVER = ~u64{0};
+
+  struct sample {
+    u16 bank; // ROM bank at pc, 0 outside the cartridge ROM
+    u16 pc;
+    u64 count;
+  };
+
+  // sample every _interval T-cycles from _clock on
+  auto start(u32 _interval, u64 _clock) -> void {
+    m_interval = _interval ? _interval : 1;
+    m_due = _clock;
+  }
+  auto stop() -> void { m_due = NEVER; }
+  auto running() const -> bool { return m_due != NEVER; }
+
+  // bus clock of the next sample; step() compares against it
+  auto due() const -> u64 { return m_due; }
+  // bank:pc at _clock, once due()
+  auto record(u16 _bank, u16 _pc, u64 _clock) -> void {
+    const u64 count = (_clock - m_due) / m_interval + 1;
+    m_counts[static_cast<u32>(_bank) << 16 | _pc] += count;
+    m_samples += count;
+    m_due += count * m_interval;
+  }
+
+  auto interval() const -> u32 { return m_interval; }
+  auto samples() const -> u64 { return m_samples; }
+  // every sampled bank:pc, most frequent first
+  auto histogram() const -> std::vector<sample>;
+  auto clear() -> void {
+    m_counts.clear();
+    m_samples = 0;
+  }
+
+  // text histogram: a header line with the interval, then "bb:aaaa count"
+  auto save(const std::string &_path) const -> void;
+  // histogram of a file written by save(); sampling interval in _interval
+  static auto load(const std::string &_path, u32 &_interval)
+      -> std::vector<sample>;
+
+private:
+  std::unordered_map<u32, u64> m_counts; // bank << 16 | pc
+  u64 m_due = NEVER;
+  u64 m_samples = 0;
+  u32 m_interval = 1;
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,73 @@
+#include "save_file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mpu {
+
+namespace {
+auto os_error(const std::string &_what) -> mpu_runtime_error {
+  return mpu_runtime_error(_what + ": " + std::strerror(errno));
+}
+} // namespace
+
+save_file::save_file(const std::string &_path, std::size_t _size,
+                     clk::duration _interval)
+    : m_path(_path), m_size(_size), m_interval(_interval) {
+  if (_size == 0)
+    throw mpu_runtime_error("save file " + _path + " would be empty");
+
+  const int fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw os_error("cannot open " + _path);
+
+  struct stat info {};
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw os_error("cannot stat " + _path);
+  }
+  m_mapped = std::max(_size, static_cast<std::size_t>(info.st_size));
+  if (static_cast<std::size_t>(info.st_size) < m_mapped &&
+      ::ftruncate(fd, static_cast<off_t>(m_mapped)) != 0) {
+    ::close(fd);
+    throw os_error("cannot resize " + _path);
+  }
+
+  void *mapping =
+      ::mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd); // the mapping keeps the file open
+  if (mapping == MAP_FAILED)
+    throw os_error("cannot map " + _path);
+  m_data = static_cast<u8 *>(mapping);
+
+  m_flusher = std::thread(&save_file::__flush_loop, this);
+}
+
+save_file::~save_file() {
+  {
+    std::lock_guard guard(m_lock);
+    m_stop = true;
+  }
+  m_wake.notify_one();
+  m_flusher.join();
+  ::msync(m_data, m_mapped, MS_SYNC);
+  ::munmap(m_data, m_mapped);
+}
+
+auto save_file::flush() -> void {
+  if (::msync(m_data, m_mapped, MS_SYNC) != 0)
+    throw os_error("cannot write " + m_path);
+}
+
+// clean pages cost the kernel nothing, so there is no dirty tracking here
+auto save_file::__flush_loop() -> void {
+  std::unique_lock guard(m_lock);
+  while (!m_wake.wait_for(guard, m_interval, [this] { return m_stop; }))
+    ::msync(m_data, m_mapped, MS_SYNC);
+}
+
+} // namespace mpu
@@ -0,0 +1,58 @@
+#ifndef __CORE_SAVE_FILE_HPP
+#define __CORE_SAVE_FILE_HPP
+
+#include "common.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mpu {
+
+/**
+ * Memory-mapped save file
+ * @brief battery-backed cartridge RAM living directly in a MAP_SHARED
+ * mapping of the .sav file, so guest writes are plain stores and reach
+ * the page cache with no copy.
+ *
+ * A background thread msync()s the mapping every `_interval`, so the data
+ * reaches the disk while the game runs; the last flush happens on
+ * destruction. The file is grown to `_size` if it is shorter, and a longer
+ * file keeps its tail (other emulators append an RTC footer there).
+ */
+struct save_file {
+  constexpr static auto INTERVAL = std::chrono::seconds(1);
+
+  save_file(const std::string &_path, std::size_t _size,
+            clk::duration _interval = INTERVAL);
+  ~save_file();
+
+  save_file(const save_file &) = delete;
+  save_file &operator=(const save_file &) = delete;
+
+  auto data() -> u8 * { return m_data; }
+  auto size() const -> std::size_t { return m_size; }
+  auto path() const -> const std::string & { return m_path; }
+
+  // write the mapping back now, blocking
+  auto flush() -> void;
+
+private:
+  std::string m_path;
+  u8 *m_data = nullptr;
+  std::size_t m_size = 0;
+  std::size_t m_mapped = 0; // whole file, m_size or more
+
+  clk::duration m_interval;
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  bool m_stop = false;
+  std::thread m_flusher;
+
+  auto __flush_loop() -> void;
+};
+
+} // namespace mpu
+
+#endif
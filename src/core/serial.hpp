@@ -0,0 +1,98 @@
+#ifndef __CORE_SERIAL_HPP
+#define __CORE_SERIAL_HPP
+
+#include "common.hpp"
+#include <algorithm>
+
+namespace mpu {
+
+/**
+ * Serial port (SB 0xFF01, SC 0xFF02)
+ * @brief shifts one byte per transfer with the peer on the other end of
+ * the link cable; transfers are scheduled events on the bus clock instead
+ * of being clocked bit by bit.
+ *
+ * The side with SC = 0x81 (internal clock) drives the transfer. When its
+ * 8 bits have shifted it swaps SB with the peer, provided the peer is
+ * waiting with SC = 0x80, and the peer receives the byte at the matching
+ * point of its own clock. With no peer (or an idle one) the master reads
+ * 0xFF, like an unplugged cable.
+ */
+struct serial {
+  constexpr static u64 IDLE = ~u64{0};
+  constexpr static u64 TRANSFER_CYCLES = 8 * 512; // 8 bits at 8192 Hz
+
+  u8 data = 0;    // SB
+  u8 control = 0; // SC
+
+  serial *peer = nullptr;
+  long long skew = 0;    // peer clock minus our clock
+  u64 next_event = IDLE; // earliest clock at which tick() has work to do
+
+  auto read_control() const -> u8 { return control | 0x7E; }
+
+  auto write_control(u8 _value, u64 _clock) -> void {
+    control = _value & 0x81;
+    m_done = (control & 0x81) == 0x81 ? _clock + TRANSFER_CYCLES : IDLE;
+    __reschedule();
+  }
+
+  // advance to _clock, true when a byte finished shifting (serial interrupt)
+  auto tick(u64 _clock) -> bool {
+    if (_clock < next_event)
+      return false;
+    return __complete(_clock);
+  }
+
+  // members in encoding order, see state_io.hpp; the cable (peer, skew)
+  // belongs to the host and is left out
+  template <typename S, typename F>
+  static auto fields(S &_s, F &&_f) -> void {
+    _f(_s.data, _s.control, _s.next_event, _s.m_done, _s.m_arrival,
+       _s.m_incoming);
+  }
+
+private:
+  u64 m_done = IDLE;    // our clock when the transfer we drive completes
+  u64 m_arrival = IDLE; // our clock when the peer's byte lands in SB
+  u8 m_incoming = 0xFF;
+
+  auto __complete(u64 _clock) -> bool {
+    bool shifted = false;
+
+    if (_clock >= m_done) {
+      u8 received = 0xFF;
+      if (peer && (peer->control & 0x81) == 0x80) {
+        received = peer->data;
+        peer->__deliver(data, static_cast<u64>(
+                                  static_cast<long long>(m_done) + skew));
+      }
+      data = received;
+      control &= 0x7F;
+      m_done = IDLE;
+      shifted = true;
+    }
+
+    if (_clock >= m_arrival) {
+      data = m_incoming;
+      control &= 0x7F;
+      m_arrival = IDLE;
+      shifted = true;
+    }
+
+    __reschedule();
+    return shifted;
+  }
+
+  auto __deliver(u8 _byte, u64 _at) -> void {
+    m_incoming = _byte;
+    m_arrival = _at;
+    __reschedule();
+  }
+
+  auto __reschedule() -> void { next_event = std::min(m_done, m_arrival); }
+};
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,109 @@
+#include "state_io.hpp"
+#include <array>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace mpu {
+
+namespace {
+template <typename T> struct is_array : std::false_type {};
+template <typename T, std::size_t N>
+struct is_array<std::array<T, N>> : std::true_type {};
+
+// _visit.scalar() for every scalar below _value and _visit.bytes() for
+// every byte array, in fields() order
+template <typename V, typename T> auto walk(V &_visit, T &_value) -> void {
+  using plain = std::remove_const_t<T>;
+  if constexpr (std::is_arithmetic_v<plain> || std::is_enum_v<plain>) {
+    _visit.scalar(_value);
+  } else if constexpr (is_array<plain>::value) {
+    if constexpr (std::is_same_v<typename plain::value_type, u8>)
+      _visit.bytes(_value.data(), _value.size());
+    else
+      for (auto &element : _value)
+        walk(_visit, element);
+  } else {
+    plain::fields(_value,
+                  [&](auto &..._members) { (walk(_visit, _members), ...); });
+  }
+}
+
+// scalar as an unsigned integer of the same width
+template <typename T> auto bits(const T &_value) -> u64 {
+  if constexpr (std::is_floating_point_v<T>) {
+    static_assert(sizeof(T) == 4, "floats are stored as 32 bits");
+    u32 word;
+    std::memcpy(&word, &_value, sizeof(word));
+    return word;
+  } else {
+    return static_cast<u64>(_value);
+  }
+}
+
+struct counter {
+  std::size_t size = 0;
+
+  template <typename T> auto scalar(const T &) -> void { size += sizeof(T); }
+  auto bytes(const u8 *, std::size_t _size) -> void { size += _size; }
+};
+
+struct encoder {
+  std::vector<u8> &out;
+
+  template <typename T> auto scalar(const T &_value) -> void {
+    const u64 value = bits(_value);
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+      out.push_back(static_cast<u8>(value >> (8 * i)));
+  }
+  auto bytes(const u8 *_data, std::size_t _size) -> void {
+    out.insert(out.end(), _data, _data + _size);
+  }
+};
+struct decoder {
+  const u8 *in;
+
+  template <typename T> auto scalar(T &_value) -> void {
+    u64 value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+      value |= static_cast<u64>(*in++) << (8 * i);
+    if constexpr (std::is_floating_point_v<T>) {
+      const auto word = static_cast<u32>(value);
+      std::memcpy(&_value, &word, sizeof(word));
+    } else if constexpr (std::is_same_v<T, bool>) {
+      _value = value != 0;
+    } else {
+      _value = static_cast<T>(value);
+    }
+  }
+  auto bytes(u8 *_data, std::size_t _size) -> void {
+    std::memcpy(_data, in, _size);
+    in += _size;
+  }
+};
+} // namespace
+
+auto state_size() -> std::size_t {
+  static const std::size_t size = [] {
+    counter count;
+    const auto state = std::make_unique<CPU::snapshot>();
+    walk(count, std::as_const(*state));
+    return count.size;
+  }();
+  return size;
+}
+
+auto encode_state(const CPU::snapshot &_state, std::vector<u8> &_out)
+    -> void {
+  _out.reserve(_out.size() + state_size());
+  encoder encode{_out};
+  walk(encode, _state);
+}
+
+auto decode_state(const u8 *_data, CPU::snapshot &_state) -> void {
+  decoder decode{_data};
+  walk(decode, _state);
+}
+
+} // namespace mpu
@@ -0,0 +1,36 @@
+#ifndef __CORE_STATE_IO_HPP
+#define __CORE_STATE_IO_HPP
+
+#include "common.hpp"
+#include "cpu.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Snapshot encoding
+ * @brief CPU::snapshot as a fixed sequence of little-endian fields.
+ *
+ * Every struct inside a snapshot lists its members once, in a static
+ * fields(state, f) that passes them to f in order; the encoder follows
+ * those lists down to scalars and arrays. Padding, host pointers and the
+ * link cable never reach the bytes, so equal states encode, and hash, the
+ * same whatever the compiler or ABI. Floats are stored as their IEEE-754
+ * bits. A member missing from fields() is missing from every snapshot
+ * file and state hash, so new state goes there too.
+ */
+
+// bytes of an encoded snapshot, the same for every state
+auto state_size() -> std::size_t;
+
+// append the encoding of _state to _out
+auto encode_state(const CPU::snapshot &_state, std::vector<u8> &_out) -> void;
+
+// read _state back from state_size() bytes at _data; the link cable of
+// _state is left as it was
+auto decode_state(const u8 *_data, CPU::snapshot &_state) -> void;
+
+} // namespace mpu
+
+#endif
@@ -0,0 +1,54 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <fstream>
+
+namespace mpu {
+
+auto trace_ring::save(const std::string &_path) const -> void {
+  std::ofstream file(_path, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot create " + _path);
+
+  const u32 size = sizeof(trace_record);
+  file.write(MAGIC, sizeof(MAGIC));
+  file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  file.write(reinterpret_cast<const char *>(&m_count), sizeof(m_count));
+
+  // oldest first: from the write position on once the ring has wrapped
+  const u64 kept = std::min<u64>(m_count, m_records.size());
+  const std::size_t first = m_count > m_records.size() ? m_count & m_mask : 0;
+  const std::size_t tail = std::min<std::size_t>(kept, m_records.size() - first);
+  file.write(reinterpret_cast<const char *>(m_records.data() + first),
+             static_cast<std::streamsize>(tail * size));
+  file.write(reinterpret_cast<const char *>(m_records.data()),
+             static_cast<std::streamsize>((kept - tail) * size));
+  if (!file.flush())
+    throw mpu_runtime_error("cannot write " + _path);
+}
+
+auto trace_ring::load(const std::string &_path, u64 &_count)
+    -> std::vector<trace_record> {
+  std::ifstream file(_path, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _path);
+
+  char magic[sizeof(MAGIC)];
+  u32 size = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(&size), sizeof(size));
+  file.read(reinterpret_cast<char *>(&_count), sizeof(_count));
+  if (!file || !std::equal(magic, magic + sizeof(magic), MAGIC))
+    throw mpu_runtime_error(_path + ": not a gboy trace");
+  if (size != sizeof(trace_record))
+    throw mpu_runtime_error(_path + ": record size " + std::to_string(size) +
+                            ", expected " +
+                            std::to_string(sizeof(trace_record)));
+
+  std::vector<trace_record> records;
+  trace_record record;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record)))
+    records.push_back(record);
+  return records;
+}
+
+} // namespace mpu
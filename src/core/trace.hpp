@@ -0,0 +1,72 @@
+#ifndef __CORE_TRACE_HPP
+#define __CORE_TRACE_HPP
+
+#include "common.hpp"
+#include <bit>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mpu {
+
+/**
+ * Trace record
+ * @brief one executed instruction and the registers it started from.
+ *
+ * Fixed 32 bytes so the ring is a plain array and the file a plain dump.
+ * Register pairs are stored as CPU::snapshot holds them (first register in
+ * the low byte). Operand bytes are only kept for code outside the ROM; the
+ * decoder reads ROM operands from the image through bank:pc.
+ */
+struct trace_record {
+  u64 clock;   // bus clock before the instruction
+  u16 pc;
+  u16 bank;    // ROM bank mapped at pc (0 outside the cartridge)
+  u16 sp;
+  u8 opcode;
+  u8 operands[2]; // zero when pc is in ROM
+  u16 af, bc, de, hl;
+  u8 ime;
+  u8 reserved[5];
+};
+static_assert(sizeof(trace_record) == 32);
+
+/**
+ * Instruction trace ring
+ * @brief the last capacity() instructions of one CPU, in binary.
+ *
+ * Filled by CPU::step in GBOY_TRACE builds only; next() is a masked index
+ * into preallocated storage, so a traced instruction costs a handful of
+ * stores into the slot. save() writes the records oldest first for
+ * gboy-trace.
+ */
+struct trace_ring {
+  constexpr static char MAGIC[8] = {'G', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+
+  // _capacity is rounded up to a power of two
+  explicit trace_ring(std::size_t _capacity = 1 << 16)
+      : m_records(std::bit_ceil(_capacity)), m_mask(m_records.size() - 1) {}
+
+  // slot for the next instruction, overwriting the oldest once full
+  auto next() -> trace_record & { return m_records[m_count++ & m_mask]; }
+
+  auto capacity() const -> std::size_t { return m_records.size(); }
+  // instructions traced so far, including overwritten ones
+  auto count() const -> u64 { return m_count; }
+  auto clear() -> void { m_count = 0; }
+
+  // magic, record size, total count, then the retained records in order
+  auto save(const std::string &_path) const -> void;
+  // the records of a file written by save(); total count in _count
+  static auto load(const std::string &_path, u64 &_count)
+      -> std::vector<trace_record>;
+
+private:
+  std::vector<trace_record> m_records;
+  std::size_t m_mask;
+  u64 m_count = 0;
+};
+
+} // namespace mpu
+
+#endif
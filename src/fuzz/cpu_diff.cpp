@@ -0,0 +1,295 @@
+#include "core/cpu.hpp"
+#include "reference.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Differential fuzz target for the CPU core: every input is a register
+ * file, a memory pattern and one instruction, run once through
+ * CPU::execute_instruction on a flat 64 KiB bus (GBOY_FLAT_BUS build of
+ * the core) and once through the reference model in reference.cpp.
+ * Registers, flags, IME, HALT, all 64 KiB of memory and the T-cycle count
+ * must agree, otherwise the input is reported and the process aborts.
+ *
+ * Input layout:
+ *   0-7    A F B C D E H L (F's low nibble is dropped)
+ *   8-11   SP, PC (little-endian)
+ *   12     bit 0: IME
+ *   13     seed of the memory fill pattern
+ *   14-16  instruction bytes, placed at PC
+ *   17...  optional (address low, address high, value) memory writes,
+ *          applied before the instruction bytes
+ *
+ * The eleven unused opcodes lock the real CPU up and are skipped.
+ * GBOY_FUZZ_SKIP="cb,10" skips more, for divergences already known.
+ *
+ * Built with -fsanitize=fuzzer under Clang. Other compilers get a
+ * standalone driver (GBOY_FUZZ_STANDALONE) that replays input files or
+ * runs random inputs and summarises the failing opcodes:
+ *
+ * usage: gboy-fuzz-cpu [--runs N] [--seed S] [input...]
+ */
+
+namespace {
+using namespace mpu;
+
+constexpr std::size_t HEADER = 17;
+constexpr std::size_t MEMORY = 0x10000;
+
+struct input {
+  u8 a, f, b, c, d, e, h, l;
+  u16 sp, pc;
+  bool ime;
+  u8 seed;
+  u8 bytes[3];
+};
+
+auto hex(unsigned _value, int _width = 2) -> std::string {
+  char text[8];
+  std::snprintf(text, sizeof(text), "%0*x", _width, _value);
+  return text;
+}
+
+auto parse(const u8 *_data) -> input {
+  input in{};
+  in.a = _data[0];
+  in.f = _data[1] & 0xF0;
+  in.b = _data[2];
+  in.c = _data[3];
+  in.d = _data[4];
+  in.e = _data[5];
+  in.h = _data[6];
+  in.l = _data[7];
+  in.sp = static_cast<u16>(_data[8] | _data[9] << 8);
+  in.pc = static_cast<u16>(_data[10] | _data[11] << 8);
+  in.ime = _data[12] & 1;
+  in.seed = _data[13];
+  std::memcpy(in.bytes, _data + 14, 3);
+  return in;
+}
+
+auto illegal(u8 _opcode) -> bool {
+  switch (_opcode) {
+  case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB:
+  case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// opcodes listed in GBOY_FUZZ_SKIP, read once
+auto skipped(u8 _opcode) -> bool {
+  static const auto mask = [] {
+    std::array<bool, 0x100> skip{};
+    if (const char *list = std::getenv("GBOY_FUZZ_SKIP"))
+      for (const char *at = list; *at;) {
+        char *end;
+        const unsigned long opcode = std::strtoul(at, &end, 16);
+        if (end == at) {
+          ++at;
+          continue;
+        }
+        skip[opcode & 0xFF] = true;
+        at = end;
+      }
+    return skip;
+  }();
+  return illegal(_opcode) || mask[_opcode];
+}
+
+// same memory for both sides: a cheap pattern, then the input's writes,
+// then the instruction at pc
+auto fill(u8 *_memory, const input &_in, const u8 *_data, std::size_t _size)
+    -> void {
+  for (std::size_t i = 0; i < MEMORY; ++i)
+    _memory[i] = static_cast<u8>(i * 0x9D + (i >> 8) + _in.seed * 0x3B);
+  for (std::size_t i = HEADER; i + 3 <= _size; i += 3)
+    _memory[_data[i] | _data[i + 1] << 8] = _data[i + 2];
+  for (u16 i = 0; i < 3; ++i)
+    _memory[static_cast<u16>(_in.pc + i)] = _in.bytes[i];
+}
+
+auto describe(const input &_in) -> std::string {
+  return "AF=" + hex(_in.a) + hex(_in.f) + " BC=" + hex(_in.b) + hex(_in.c) +
+         " DE=" + hex(_in.d) + hex(_in.e) + " HL=" + hex(_in.h) + hex(_in.l) +
+         " SP=" + hex(_in.sp, 4) + " PC=" + hex(_in.pc, 4) +
+         " IME=" + std::to_string(_in.ime) + " bytes " + hex(_in.bytes[0]) +
+         " " + hex(_in.bytes[1]) + " " + hex(_in.bytes[2]);
+}
+
+// first difference between the core and the model, empty if they agree
+auto compare(const CPU &_cpu, u32 _cycles, const reference::machine &_model)
+    -> std::string {
+  const struct {
+    const char *name;
+    unsigned ours;
+    unsigned theirs;
+  } fields[] = {
+      {"a", _cpu.get_psw().A, _model.a},
+      {"f", _cpu.get_psw().F, _model.f},
+      {"b", _cpu.get_bc().B, _model.b},
+      {"c", _cpu.get_bc().C, _model.c},
+      {"d", _cpu.get_de().D, _model.d},
+      {"e", _cpu.get_de().E, _model.e},
+      {"h", _cpu.get_hl().H, _model.h},
+      {"l", _cpu.get_hl().L, _model.l},
+      {"sp", _cpu.get_sp().SP, _model.sp},
+      {"pc", _cpu.get_pc(), _model.pc},
+      {"ime", _cpu.INTERRUPT_ENABLE, _model.ime},
+      {"halt", _cpu.halted(), _model.halted},
+      {"cycles", _cycles, _model.cycles},
+  };
+  for (const auto &field : fields)
+    if (field.ours != field.theirs)
+      return std::string(field.name) + " " + hex(field.ours) +
+             " != " + hex(field.theirs);
+
+  const u8 *ours = _cpu.get_bus().flat.data();
+  const auto [mine, theirs] = std::mismatch(ours, ours + MEMORY, _model.memory);
+  if (mine != ours + MEMORY)
+    return "[" + hex(static_cast<unsigned>(mine - ours), 4) + "] " +
+           hex(*mine) + " != " + hex(*theirs);
+  return {};
+}
+
+// run one input through both sides; empty when skipped or equal
+auto check(const u8 *_data, std::size_t _size) -> std::string {
+  if (_size < HEADER)
+    return {};
+  const input in = parse(_data);
+  const u8 opcode = in.bytes[0];
+  if (skipped(opcode))
+    return {};
+
+  // the core has no way to leave HALT without stepping, so a halted one is
+  // replaced rather than reused
+  static std::unique_ptr<CPU> cpu;
+  static std::unique_ptr<u8[]> memory(new u8[MEMORY]);
+  if (!cpu || cpu->halted())
+    cpu = std::make_unique<CPU>();
+
+  auto &bus = cpu->get_bus();
+  fill(memory.get(), in, _data, _size);
+  std::copy(memory.get(), memory.get() + MEMORY, bus.flat.begin());
+
+  reference::machine model{in.a,  in.f,  in.b,  in.c,  in.d,
+                           in.e,  in.h,  in.l,  in.sp, in.pc,
+                           in.ime};
+  model.memory = memory.get();
+  model.step();
+
+  cpu->set_acc(in.a);
+  cpu->set_flags(in.f);
+  cpu->set_b(in.b);
+  cpu->set_c(in.c);
+  cpu->set_d(in.d);
+  cpu->set_e(in.e);
+  cpu->set_h(in.h);
+  cpu->set_l(in.l);
+  cpu->set_sp(in.sp);
+  cpu->INTERRUPT_ENABLE = in.ime;
+  cpu->set_pc(static_cast<u16>(in.pc + 1));
+  try {
+    cpu->execute_instruction(opcode);
+  } catch (std::exception &error) {
+    return std::string("core threw: ") + error.what();
+  }
+  return compare(*cpu, CPU::instruction_cycles(opcode, in.pc, cpu->get_pc()),
+                 model);
+}
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  const std::string failure = check(data, size);
+  if (!failure.empty()) {
+    std::fprintf(stderr, "opcode %s: %s\n  %s\n", hex(data[14]).c_str(),
+                 failure.c_str(), describe(parse(data)).c_str());
+    std::abort();
+  }
+  return 0;
+}
+
+#ifdef GBOY_FUZZ_STANDALONE
+int main(int argc, char **argv) {
+  u64 runs = 1'000'000;
+  u64 seed = 1;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--runs" && i + 1 < argc)
+      runs = std::stoull(argv[++i]);
+    else if (arg == "--seed" && i + 1 < argc)
+      seed = std::stoull(argv[++i]);
+    else if (arg.starts_with("-")) {
+      std::cerr << "usage: gboy-fuzz-cpu [--runs N] [--seed S] [input...]"
+                << std::endl;
+      return 2;
+    } else
+      files.push_back(arg);
+  }
+
+  // replay, as libFuzzer does with crash files
+  if (!files.empty()) {
+    int failed = 0;
+    for (const std::string &file : files) {
+      std::ifstream stream(file, std::ios::binary);
+      const std::vector<u8> data(std::istreambuf_iterator<char>(stream), {});
+      const std::string failure = check(data.data(), data.size());
+      if (!failure.empty()) {
+        ++failed;
+        std::cout << file << ": " << failure << "\n  "
+                  << describe(parse(data.data())) << std::endl;
+      }
+    }
+    return failed ? 1 : 0;
+  }
+
+  // random inputs; the first failure of every opcode is kept
+  struct outcome {
+    u64 runs = 0;
+    u64 failed = 0;
+    std::string first;
+  };
+  std::vector<outcome> opcodes(0x100);
+  std::mt19937_64 random(seed);
+  u8 data[HEADER + 3 * 4];
+  const auto start = clk::now();
+  for (u64 run = 0; run < runs; ++run) {
+    for (std::size_t i = 0; i < sizeof(data); i += 8) {
+      const u64 bits = random();
+      std::memcpy(data + i, &bits, std::min<std::size_t>(8, sizeof(data) - i));
+    }
+    const std::size_t size = HEADER + 3 * (random() % 5);
+    outcome &result = opcodes[data[14]];
+    ++result.runs;
+    const std::string failure = check(data, size);
+    if (!failure.empty() && result.failed++ == 0)
+      result.first = failure + "\n      " + describe(parse(data));
+  }
+  const std::chrono::duration<double> elapsed = clk::now() - start;
+
+  std::size_t failing = 0;
+  for (unsigned opcode = 0; opcode < 0x100; ++opcode) {
+    const outcome &result = opcodes[opcode];
+    if (!result.failed)
+      continue;
+    ++failing;
+    std::printf("%s  %6llu/%-6llu %s\n", hex(opcode).c_str(), result.failed,
+                result.runs, result.first.c_str());
+  }
+  std::cout << failing << " opcodes diverge, " << runs << " inputs in "
+            << elapsed.count() << " s" << std::endl;
+  return failing ? 1 : 0;
+}
+#endif
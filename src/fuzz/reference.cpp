@@ -0,0 +1,431 @@
+#include "reference.hpp"
+
+namespace mpu::reference {
+
+namespace {
+constexpr u8 Z = 0x80, N = 0x40, H = 0x20, C = 0x10;
+constexpr u8 HL_INDIRECT = 6; // r8 index of [HL]
+using i8 = signed char;
+
+auto zero(u8 _value) -> u8 { return _value ? 0 : Z; }
+} // namespace
+
+auto machine::__fetch16() -> u16 {
+  const u8 low = __fetch();
+  return static_cast<u16>(low | __fetch() << 8);
+}
+
+// r8 order of the encoding: B C D E H L [HL] A
+auto machine::__reg(u8 _index) -> u8 {
+  switch (_index) {
+  case 0: return b;
+  case 1: return c;
+  case 2: return d;
+  case 3: return e;
+  case 4: return h;
+  case 5: return l;
+  case 6: return memory[__pair(2, false)];
+  default: return a;
+  }
+}
+
+auto machine::__set_reg(u8 _index, u8 _value) -> void {
+  switch (_index) {
+  case 0: b = _value; break;
+  case 1: c = _value; break;
+  case 2: d = _value; break;
+  case 3: e = _value; break;
+  case 4: h = _value; break;
+  case 5: l = _value; break;
+  case 6: memory[__pair(2, false)] = _value; break;
+  default: a = _value; break;
+  }
+}
+
+// r16 order: BC DE HL, then SP or AF
+auto machine::__pair(u8 _index, bool _af) const -> u16 {
+  switch (_index) {
+  case 0: return static_cast<u16>(b << 8 | c);
+  case 1: return static_cast<u16>(d << 8 | e);
+  case 2: return static_cast<u16>(h << 8 | l);
+  default: return _af ? static_cast<u16>(a << 8 | f) : sp;
+  }
+}
+
+auto machine::__set_pair(u8 _index, u16 _value, bool _af) -> void {
+  const u8 high = static_cast<u8>(_value >> 8), low = static_cast<u8>(_value);
+  switch (_index) {
+  case 0: b = high, c = low; break;
+  case 1: d = high, e = low; break;
+  case 2: h = high, l = low; break;
+  default:
+    if (_af)
+      a = high, f = low & 0xF0;
+    else
+      sp = _value;
+  }
+}
+
+// NZ Z NC C
+auto machine::__condition(u8 _index) const -> bool {
+  const bool set = f & (_index < 2 ? Z : C);
+  return _index & 1 ? set : !set;
+}
+
+auto machine::__push(u16 _value) -> void {
+  memory[--sp] = static_cast<u8>(_value >> 8);
+  memory[--sp] = static_cast<u8>(_value);
+}
+
+auto machine::__pop() -> u16 {
+  const u8 low = memory[sp++];
+  return static_cast<u16>(low | memory[sp++] << 8);
+}
+
+// ADD ADC SUB SBC AND XOR OR CP
+auto machine::__alu(u8 _op, u8 _value) -> void {
+  const u8 carry = (_op == 1 || _op == 3) && (f & C) ? 1 : 0;
+  u8 result;
+  switch (_op) {
+  case 0:
+  case 1: {
+    const unsigned sum = a + _value + carry;
+    result = static_cast<u8>(sum);
+    f = zero(result) | ((a & 0xF) + (_value & 0xF) + carry > 0xF ? H : 0) |
+        (sum > 0xFF ? C : 0);
+    a = result;
+    return;
+  }
+  case 2:
+  case 3:
+  case 7: {
+    result = static_cast<u8>(a - _value - carry);
+    f = zero(result) | N | ((a & 0xF) < (_value & 0xF) + carry ? H : 0) |
+        (a < _value + carry ? C : 0);
+    if (_op != 7)
+      a = result;
+    return;
+  }
+  case 4:
+    a &= _value;
+    f = zero(a) | H;
+    return;
+  case 5:
+    a ^= _value;
+    f = zero(a);
+    return;
+  default:
+    a |= _value;
+    f = zero(a);
+    return;
+  }
+}
+
+// 0xCB page: rotates and shifts, BIT, RES, SET
+auto machine::__prefixed() -> void {
+  const u8 op = __fetch();
+  const u8 x = op >> 6, y = op >> 3 & 7, z = op & 7;
+  const u8 value = __reg(z);
+  cycles = z == HL_INDIRECT ? (x == 1 ? 12 : 16) : 8;
+
+  switch (x) {
+  case 0: {
+    u8 result, out;
+    switch (y) {
+    case 0: out = value >> 7, result = static_cast<u8>(value << 1 | out); break;
+    case 1: out = value & 1, result = static_cast<u8>(value >> 1 | out << 7); break;
+    case 2: out = value >> 7, result = static_cast<u8>(value << 1 | (f & C ? 1 : 0)); break;
+    case 3: out = value & 1, result = static_cast<u8>(value >> 1 | (f & C ? 0x80 : 0)); break;
+    case 4: out = value >> 7, result = static_cast<u8>(value << 1); break;
+    case 5: out = value & 1, result = static_cast<u8>(value >> 1 | (value & 0x80)); break;
+    case 6: out = 0, result = static_cast<u8>(value << 4 | value >> 4); break;
+    default: out = value & 1, result = value >> 1; break;
+    }
+    f = zero(result) | (out ? C : 0);
+    __set_reg(z, result);
+    break;
+  }
+  case 1:
+    f = zero(value & (1 << y)) | H | (f & C);
+    break;
+  case 2:
+    __set_reg(z, value & ~(1 << y));
+    break;
+  default:
+    __set_reg(z, value | 1 << y);
+    break;
+  }
+}
+
+auto machine::step() -> void {
+  illegal = false;
+  const u8 op = __fetch();
+  const u8 x = op >> 6, y = op >> 3 & 7, z = op & 7;
+  const u8 p = y >> 1, q = y & 1;
+
+  if (x == 1) {
+    if (op == 0x76) { // HALT
+      halted = true;
+      cycles = 4;
+    } else {
+      __set_reg(y, __reg(z));
+      cycles = y == HL_INDIRECT || z == HL_INDIRECT ? 8 : 4;
+    }
+    return;
+  }
+  if (x == 2) {
+    __alu(y, __reg(z));
+    cycles = z == HL_INDIRECT ? 8 : 4;
+    return;
+  }
+
+  if (x == 0) {
+    switch (z) {
+    case 0:
+      if (y == 0) { // NOP
+        cycles = 4;
+      } else if (y == 1) { // LD [a16], SP
+        const u16 addr = __fetch16();
+        memory[addr] = static_cast<u8>(sp);
+        memory[static_cast<u16>(addr + 1)] = static_cast<u8>(sp >> 8);
+        cycles = 20;
+      } else if (y == 2) { // STOP, two bytes long
+        ++pc;
+        cycles = 4;
+      } else { // JR, JR cc
+        const auto offset = static_cast<i8>(__fetch());
+        const bool taken = y == 3 || __condition(y - 4);
+        if (taken)
+          pc = static_cast<u16>(pc + offset);
+        cycles = taken ? 12 : 8;
+      }
+      return;
+    case 1:
+      if (q == 0) { // LD r16, u16
+        __set_pair(p, __fetch16(), false);
+        cycles = 12;
+      } else { // ADD HL, r16
+        const u16 hl = __pair(2, false), value = __pair(p, false);
+        f = (f & Z) | ((hl & 0xFFF) + (value & 0xFFF) > 0xFFF ? H : 0) |
+            (hl + value > 0xFFFF ? C : 0);
+        __set_pair(2, static_cast<u16>(hl + value), false);
+        cycles = 8;
+      }
+      return;
+    case 2: { // LD [r16], A and LD A, [r16] with HL+ and HL-
+      const u16 addr = __pair(p < 2 ? p : 2, false);
+      if (q == 0)
+        memory[addr] = a;
+      else
+        a = memory[addr];
+      if (p == 2)
+        __set_pair(2, static_cast<u16>(addr + 1), false);
+      else if (p == 3)
+        __set_pair(2, static_cast<u16>(addr - 1), false);
+      cycles = 8;
+      return;
+    }
+    case 3: // INC r16, DEC r16
+      __set_pair(p, static_cast<u16>(__pair(p, false) + (q ? -1 : 1)), false);
+      cycles = 8;
+      return;
+    case 4: { // INC r8
+      const u8 result = static_cast<u8>(__reg(y) + 1);
+      __set_reg(y, result);
+      f = zero(result) | ((result & 0xF) == 0 ? H : 0) | (f & C);
+      cycles = y == HL_INDIRECT ? 12 : 4;
+      return;
+    }
+    case 5: { // DEC r8
+      const u8 result = static_cast<u8>(__reg(y) - 1);
+      __set_reg(y, result);
+      f = zero(result) | N | ((result & 0xF) == 0xF ? H : 0) | (f & C);
+      cycles = y == HL_INDIRECT ? 12 : 4;
+      return;
+    }
+    case 6: // LD r8, u8
+      __set_reg(y, __fetch());
+      cycles = y == HL_INDIRECT ? 12 : 8;
+      return;
+    default:
+      cycles = 4;
+      switch (y) {
+      case 0: // RLCA
+        f = a & 0x80 ? C : 0;
+        a = static_cast<u8>(a << 1 | a >> 7);
+        return;
+      case 1: // RRCA
+        f = a & 1 ? C : 0;
+        a = static_cast<u8>(a >> 1 | a << 7);
+        return;
+      case 2: { // RLA
+        const u8 in = f & C ? 1 : 0;
+        f = a & 0x80 ? C : 0;
+        a = static_cast<u8>(a << 1 | in);
+        return;
+      }
+      case 3: { // RRA
+        const u8 in = f & C ? 0x80 : 0;
+        f = a & 1 ? C : 0;
+        a = static_cast<u8>(a >> 1 | in);
+        return;
+      }
+      case 4: { // DAA
+        u8 carry = f & C;
+        if (f & N) {
+          if (carry)
+            a -= 0x60;
+          if (f & H)
+            a -= 0x06;
+        } else {
+          if (carry || a > 0x99) {
+            a += 0x60;
+            carry = C;
+          }
+          if ((f & H) || (a & 0xF) > 9)
+            a += 0x06;
+        }
+        f = zero(a) | (f & N) | carry;
+        return;
+      }
+      case 5: // CPL
+        a = static_cast<u8>(~a);
+        f = (f & (Z | C)) | N | H;
+        return;
+      case 6: // SCF
+        f = (f & Z) | C;
+        return;
+      default: // CCF
+        f = (f & Z) | (f & C ? 0 : C);
+        return;
+      }
+    }
+  }
+
+  // x == 3
+  switch (z) {
+  case 0:
+    if (y < 4) { // RET cc
+      const bool taken = __condition(y);
+      if (taken)
+        pc = __pop();
+      cycles = taken ? 20 : 8;
+    } else if (y == 4 || y == 6) { // LDH [a8], A and LDH A, [a8]
+      const u16 addr = static_cast<u16>(0xFF00 | __fetch());
+      if (y == 4)
+        memory[addr] = a;
+      else
+        a = memory[addr];
+      cycles = 12;
+    } else { // ADD SP, i8 and LD HL, SP + i8
+      const u8 offset = __fetch();
+      const u16 result = static_cast<u16>(sp + static_cast<i8>(offset));
+      f = ((sp & 0xF) + (offset & 0xF) > 0xF ? H : 0) |
+          ((sp & 0xFF) + offset > 0xFF ? C : 0);
+      if (y == 5) {
+        sp = result;
+        cycles = 16;
+      } else {
+        __set_pair(2, result, false);
+        cycles = 12;
+      }
+    }
+    return;
+  case 1:
+    if (q == 0) { // POP r16
+      __set_pair(p, __pop(), true);
+      cycles = 12;
+    } else if (p < 2) { // RET, RETI
+      pc = __pop();
+      if (p == 1)
+        ime = true;
+      cycles = 16;
+    } else if (p == 2) { // JP HL
+      pc = __pair(2, false);
+      cycles = 4;
+    } else { // LD SP, HL
+      sp = __pair(2, false);
+      cycles = 8;
+    }
+    return;
+  case 2:
+    if (y < 4) { // JP cc, a16
+      const u16 target = __fetch16();
+      const bool taken = __condition(y);
+      if (taken)
+        pc = target;
+      cycles = taken ? 16 : 12;
+    } else { // LD [C], A  LD [a16], A  LD A, [C]  LD A, [a16]
+      const bool immediate = y & 1;
+      const u16 addr = immediate ? __fetch16() : static_cast<u16>(0xFF00 | c);
+      if (y < 6)
+        memory[addr] = a;
+      else
+        a = memory[addr];
+      cycles = immediate ? 16 : 8;
+    }
+    return;
+  case 3:
+    switch (y) {
+    case 0: // JP a16
+      pc = __fetch16();
+      cycles = 16;
+      return;
+    case 1:
+      __prefixed();
+      return;
+    case 6: // DI
+      ime = false;
+      cycles = 4;
+      return;
+    case 7: // EI
+      ime = true;
+      cycles = 4;
+      return;
+    default:
+      break;
+    }
+    break;
+  case 4:
+    if (y < 4) { // CALL cc, a16
+      const u16 target = __fetch16();
+      const bool taken = __condition(y);
+      if (taken) {
+        __push(pc);
+        pc = target;
+      }
+      cycles = taken ? 24 : 12;
+      return;
+    }
+    break;
+  case 5:
+    if (q == 0) { // PUSH r16
+      __push(__pair(p, true));
+      cycles = 16;
+      return;
+    }
+    if (p == 0) { // CALL a16
+      const u16 target = __fetch16();
+      __push(pc);
+      pc = target;
+      cycles = 24;
+      return;
+    }
+    break;
+  case 6: // ALU A, u8
+    __alu(y, __fetch());
+    cycles = 8;
+    return;
+  default: // RST
+    __push(pc);
+    pc = static_cast<u16>(y * 8);
+    cycles = 16;
+    return;
+  }
+
+  // D3 DB DD E3 E4 EB EC ED F4 FC FD
+  illegal = true;
+  cycles = 4;
+}
+
+} // namespace mpu::reference
@@ -0,0 +1,48 @@
+#ifndef __FUZZ_REFERENCE_HPP
+#define __FUZZ_REFERENCE_HPP
+
+#include "core/common.hpp"
+
+namespace mpu::reference {
+
+/**
+ * Reference SM83 interpreter
+ * @brief a compact, independent model of one instruction step for
+ * differential testing of CPU::execute_instruction.
+ *
+ * Opcodes are decoded from their bit fields (x = bits 7-6, y = 5-3,
+ * z = 2-0) instead of one case per opcode, so it shares no code or
+ * structure with the core. Memory is a flat 64 KiB owned by the caller.
+ * Timing is the documented T-cycle count including taken branches.
+ * EI takes effect at once (the one-instruction delay is not modelled)
+ * and the eleven unused opcodes only set `illegal`.
+ */
+struct machine {
+  u8 a = 0, f = 0, b = 0, c = 0, d = 0, e = 0, h = 0, l = 0;
+  u16 sp = 0, pc = 0;
+  bool ime = false;
+  bool halted = false;
+  bool illegal = false; // last opcode does not exist on the SM83
+  u32 cycles = 0;       // T-cycles of the last step
+  u8 *memory = nullptr; // 64 KiB
+
+  // execute the instruction at pc
+  auto step() -> void;
+
+private:
+  auto __fetch() -> u8 { return memory[pc++]; }
+  auto __fetch16() -> u16;
+  auto __reg(u8 _index) -> u8;
+  auto __set_reg(u8 _index, u8 _value) -> void;
+  auto __pair(u8 _index, bool _af) const -> u16;
+  auto __set_pair(u8 _index, u16 _value, bool _af) -> void;
+  auto __condition(u8 _index) const -> bool;
+  auto __push(u16 _value) -> void;
+  auto __pop() -> u16;
+  auto __alu(u8 _op, u8 _value) -> void;
+  auto __prefixed() -> void;
+};
+
+} // namespace mpu::reference
+
+#endif
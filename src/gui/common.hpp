@@ -0,0 +1,62 @@
+#ifndef __GUI_COMMON_HPP
+#define __GUI_COMMON_HPP
+
+#include "core/common.hpp"
+#include "core/ppu.hpp"
+#include <array>
+#include <atomic>
+
+namespace gui {
+using mpu::u32;
+using mpu::u8;
+
+// one completed frame of PPU shades (0-3)
+using frame = std::array<u8, mpu::ppu::WIDTH * mpu::ppu::HEIGHT>;
+
+// ARGB8888 colors for the four DMG shades
+constexpr std::array<u32, 4> PALETTE = mpu::ppu::PALETTE;
+
+/**
+ * Triple buffer
+ * @brief lock-free handoff of the latest value from one producer to one
+ * consumer; neither side ever waits, the consumer may skip stale frames.
+ *
+ * The producer fills back() and publishes it by swapping it with the shared
+ * slot; the consumer swaps the shared slot into front() when it is fresh.
+ */
+template <typename T> struct triple_buffer {
+  // producer: slot to fill with the next value
+  auto back() -> T & { return m_slots[m_back]; }
+
+  // producer: hand back() over, taking the shared slot in exchange
+  auto publish() -> void {
+    const u8 previous =
+        m_shared.exchange(m_back | FRESH, std::memory_order_acq_rel);
+    m_back = previous & INDEX;
+  }
+
+  // consumer: move to the newest published value, false if nothing new
+  auto update() -> bool {
+    if (!(m_shared.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    const u8 previous = m_shared.exchange(m_front, std::memory_order_acq_rel);
+    m_front = previous & INDEX;
+    return true;
+  }
+
+  // consumer: current value
+  auto front() const -> const T & { return m_slots[m_front]; }
+
+private:
+  constexpr static u8 INDEX = 0x3;
+  constexpr static u8 FRESH = 0x4;
+
+  std::array<T, 3> m_slots{};
+  u8 m_back = 0;
+  alignas(64) std::atomic<u8> m_shared{1};
+  alignas(64) u8 m_front = 2;
+};
+
+} // namespace gui
+
+#endif
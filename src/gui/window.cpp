@@ -0,0 +1,257 @@
+#include "window.hpp"
+#include <SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace gui {
+
+namespace {
+auto sdl_error(const char *_what) -> mpu::mpu_runtime_error {
+  return mpu::mpu_runtime_error(std::string(_what) + ": " + SDL_GetError());
+}
+} // namespace
+
+window::window(mpu::CPU &_cpu, int _scale, u32 _run_ahead)
+    : m_cpu(_cpu), m_scale(_scale), m_ahead(_cpu, _run_ahead), m_fast(_cpu) {
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
+    throw sdl_error("SDL_Init");
+
+  const int width = static_cast<int>(mpu::ppu::WIDTH);
+  const int height = static_cast<int>(mpu::ppu::HEIGHT);
+  m_window = SDL_CreateWindow("gboy", SDL_WINDOWPOS_CENTERED,
+                              SDL_WINDOWPOS_CENTERED, width * m_scale,
+                              height * m_scale, SDL_WINDOW_RESIZABLE);
+  if (!m_window)
+    throw sdl_error("SDL_CreateWindow");
+
+  m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_SOFTWARE);
+  if (!m_renderer)
+    throw sdl_error("SDL_CreateRenderer");
+  SDL_RenderSetLogicalSize(m_renderer, width, height);
+
+  m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_STREAMING, width, height);
+  if (!m_texture)
+    throw sdl_error("SDL_CreateTexture");
+
+  // no sound is not fatal, the APU ring just drops its blocks
+  SDL_AudioSpec want{};
+  SDL_AudioSpec have{};
+  want.freq = 48000;
+  want.format = AUDIO_F32SYS;
+  want.channels = 2;
+  want.samples = 512;
+  want.callback = __audio;
+  want.userdata = this;
+  m_audio = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+  if (m_audio)
+    m_cpu.get_bus().sound.set_output_rate(static_cast<u32>(have.freq));
+  else
+    std::cerr << "no audio: " << SDL_GetError() << std::endl;
+}
+
+window::~window() {
+  m_running = false;
+  if (m_emulation.joinable())
+    m_emulation.join();
+  if (m_audio)
+    SDL_CloseAudioDevice(m_audio);
+  if (m_texture)
+    SDL_DestroyTexture(m_texture);
+  if (m_renderer)
+    SDL_DestroyRenderer(m_renderer);
+  if (m_window)
+    SDL_DestroyWindow(m_window);
+  SDL_Quit();
+}
+
+auto window::run() -> int {
+  m_running = true;
+  m_emulation = std::thread(&window::__emulate, this);
+  if (m_audio)
+    SDL_PauseAudioDevice(m_audio, 0);
+
+  auto title = std::chrono::steady_clock::now();
+  while (m_running.load(std::memory_order_relaxed)) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+      if (event.type == SDL_QUIT)
+        m_running = false;
+      else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+        __key(event.key.keysym.sym, event.type == SDL_KEYDOWN);
+    }
+
+    if (m_frames.update())
+      __present();
+    else
+      SDL_Delay(1);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - title >= std::chrono::milliseconds(500)) {
+      __title();
+      title = now;
+    }
+  }
+
+  m_emulation.join();
+
+  const auto jitter = m_pace.report();
+  std::cerr << "pacing: " << jitter.frames << " frames, "
+            << jitter.mean_us << " +/- " << jitter.stddev_us
+            << " us, worst " << jitter.worst_us << " us off, " << jitter.late
+            << " late, " << jitter.resyncs << " resyncs" << std::endl;
+
+  if (m_ahead.frames()) {
+    const auto &stats = m_ahead.statistics();
+    const auto extra = std::chrono::duration_cast<std::chrono::microseconds>(
+        stats.extra_per_frame());
+    std::cerr << "run-ahead " << m_ahead.frames() << ": +" << extra.count()
+              << " us/frame (" << static_cast<int>(stats.overhead() * 100)
+              << "% over the real frame)" << std::endl;
+  }
+  return 0;
+}
+
+// emulation thread: run frame by frame and hand each finished one over
+auto window::__emulate() -> void {
+  auto &bus = m_cpu.get_bus();
+  m_pace.restart();
+  try {
+    while (m_running.load(std::memory_order_relaxed)) {
+      const bool fast = m_fast_held.load(std::memory_order_relaxed);
+      if (fast != m_fast.active()) {
+        m_fast.set_active(fast);
+        if (!fast)
+          m_pace.restart();
+      }
+
+      u8 input = m_input.load(std::memory_order_relaxed);
+      if (m_player && !m_player->done())
+        input = m_player->next();
+      if (m_recorder)
+        m_recorder->record(input);
+      bus.set_input(input);
+
+      const mpu::u64 frames = bus.video.frames;
+      bool shown = true;
+      if (fast) {
+        shown = m_fast.frame();
+      } else {
+        m_ahead.frame();
+        m_fast.measure();
+      }
+      if (shown && bus.video.frames != frames) {
+        m_frames.back() = bus.video.framebuffer;
+        m_frames.publish();
+      }
+      bus.sound.flush(bus.clock);
+
+      if (!fast)
+        m_pace.wait();
+      m_speed.store(m_fast.speed(), std::memory_order_relaxed);
+    }
+  } catch (std::runtime_error &error) {
+    std::cerr << error.what() << std::endl;
+    m_running = false;
+  }
+}
+
+auto window::__present() -> void {
+  void *pixels = nullptr;
+  int pitch = 0;
+  if (SDL_LockTexture(m_texture, nullptr, &pixels, &pitch) != 0)
+    return;
+
+  const frame &shades = m_frames.front();
+  for (u32 y = 0; y < mpu::ppu::HEIGHT; ++y) {
+    auto *row = reinterpret_cast<u32 *>(static_cast<u8 *>(pixels) + y * pitch);
+    for (u32 x = 0; x < mpu::ppu::WIDTH; ++x)
+      row[x] = PALETTE[shades[y * mpu::ppu::WIDTH + x]];
+  }
+  SDL_UnlockTexture(m_texture);
+
+  SDL_RenderClear(m_renderer);
+  SDL_RenderCopy(m_renderer, m_texture, nullptr, nullptr);
+  SDL_RenderPresent(m_renderer);
+}
+
+auto window::__key(int _key, bool _down) -> void {
+  u8 button = 0;
+  switch (_key) {
+  case SDLK_TAB:
+    m_fast_held = _down;
+    return;
+  case SDLK_RIGHT:
+    button = mpu::joypad::RIGHT;
+    break;
+  case SDLK_LEFT:
+    button = mpu::joypad::LEFT;
+    break;
+  case SDLK_UP:
+    button = mpu::joypad::UP;
+    break;
+  case SDLK_DOWN:
+    button = mpu::joypad::DOWN;
+    break;
+  case SDLK_x:
+    button = mpu::joypad::A;
+    break;
+  case SDLK_z:
+    button = mpu::joypad::B;
+    break;
+  case SDLK_BACKSPACE:
+    button = mpu::joypad::SELECT;
+    break;
+  case SDLK_RETURN:
+    button = mpu::joypad::START;
+    break;
+  default:
+    return;
+  }
+  if (_down)
+    m_input.fetch_or(button, std::memory_order_relaxed);
+  else
+    m_input.fetch_and(static_cast<u8>(~button), std::memory_order_relaxed);
+}
+
+auto window::__title() -> void {
+  std::ostringstream title;
+  title << "gboy - " << std::fixed << std::setprecision(1)
+        << m_speed.load(std::memory_order_relaxed) << "x";
+  SDL_SetWindowTitle(m_window, title.str().c_str());
+}
+
+// audio thread: drain APU blocks, silence when the core is behind
+auto window::__audio(void *_self, u8 *_stream, int _length) -> void {
+  auto &self = *static_cast<window *>(_self);
+  auto &blocks = self.m_cpu.get_bus().sound.blocks;
+  auto *out = reinterpret_cast<float *>(_stream);
+  auto wanted = static_cast<u32>(_length / (2 * sizeof(float)));
+
+  while (wanted) {
+    const mpu::audio_block *block = blocks.read_slot();
+    if (!block) {
+      std::fill(out, out + wanted * 2, 0.0f);
+      return;
+    }
+
+    const u32 n =
+        std::min(wanted, mpu::audio_block::FRAMES - self.m_audio_offset);
+    const float *from = block->samples.data() + self.m_audio_offset * 2;
+    std::copy(from, from + n * 2, out);
+    out += n * 2;
+    wanted -= n;
+
+    self.m_audio_offset += n;
+    if (self.m_audio_offset == mpu::audio_block::FRAMES) {
+      blocks.release();
+      self.m_audio_offset = 0;
+    }
+  }
+}
+
+} // namespace gui
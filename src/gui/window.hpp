@@ -0,0 +1,81 @@
+#ifndef __GUI_WINDOW_HPP
+#define __GUI_WINDOW_HPP
+
+#include "common.hpp"
+#include "core/cpu.hpp"
+#include "core/fast_forward.hpp"
+#include "core/movie.hpp"
+#include "core/pacer.hpp"
+#include "core/run_ahead.hpp"
+#include <atomic>
+#include <thread>
+
+struct SDL_Window;
+struct SDL_Renderer;
+struct SDL_Texture;
+
+namespace gui {
+
+/**
+ * SDL frontend
+ * @brief runs the core on its own thread and presents from the calling
+ * (SDL) thread, so the emulation never blocks on vsync or window events.
+ *
+ * Frames cross over through a triple buffer and audio through the APU's
+ * SPSC block ring; the software renderer is used, no GPU is required.
+ * The core is paced to the DMG frame rate; with _run_ahead frames the
+ * picture is taken that many frames ahead. Holding Tab fast-forwards, and
+ * the title bar shows the current speed.
+ *
+ * Keys: arrows, X (A), Z (B), Enter (Start), Backspace (Select). Input is
+ * sampled once per frame, which is what movies record and replay.
+ */
+struct window {
+  explicit window(mpu::CPU &_cpu, int _scale = 4, u32 _run_ahead = 0);
+  ~window();
+
+  window(const window &) = delete;
+  window &operator=(const window &) = delete;
+
+  // handle events and present until the window is closed
+  auto run() -> int;
+
+  // record the session's input, or take input from a movie until it ends;
+  // set before run()
+  auto record(mpu::movie_recorder &_recorder) -> void { m_recorder = &_recorder; }
+  auto play(mpu::movie_player &_player) -> void { m_player = &_player; }
+
+private:
+  mpu::CPU &m_cpu;
+  int m_scale;
+  mpu::run_ahead m_ahead;
+  mpu::pacer m_pace;
+  mpu::fast_forward m_fast;
+
+  SDL_Window *m_window = nullptr;
+  SDL_Renderer *m_renderer = nullptr;
+  SDL_Texture *m_texture = nullptr;
+  u32 m_audio = 0; // SDL_AudioDeviceID
+
+  triple_buffer<frame> m_frames;
+  std::atomic<bool> m_running{false};
+  std::atomic<bool> m_fast_held{false};
+  std::atomic<u8> m_input{0}; // joypad::button bits held on the keyboard
+  mpu::movie_recorder *m_recorder = nullptr;
+  mpu::movie_player *m_player = nullptr;
+  std::atomic<double> m_speed{1.0};
+  std::thread m_emulation;
+
+  // audio thread position inside the block at the head of the ring
+  u32 m_audio_offset = 0;
+
+  auto __emulate() -> void;
+  auto __present() -> void;
+  auto __title() -> void;
+  auto __key(int _key, bool _down) -> void;
+  static auto __audio(void *_self, u8 *_stream, int _length) -> void;
+};
+
+} // namespace gui
+
+#endif
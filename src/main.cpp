@@ -1,12 +1,216 @@
+#include <csignal>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include "core/cpu.hpp"
+#include "core/movie.hpp"
+#include "core/recorder.hpp"
+#include <memory>
+#ifdef GBOY_SDL
+#include "gui/window.hpp"
+#endif
 
-int main() {
+#ifndef GBOY_SDL
+namespace {
+// set by SIGINT/SIGTERM; the headless run loop stops at the next frame
+volatile std::sig_atomic_t stop_requested = 0;
+auto request_stop(int) -> void { stop_requested = 1; }
+} // namespace
+#endif
+
+// gboy [--run-ahead N] [--record file.y4m|file.rgba [--record-audio]]
+//      [--movie-record file | --movie-play file [--seek frame]]
+//      [--movie-verify file [--jobs N]] [--rtc-guest] [--trace file]
+//      [--profile file.csv|file.json]
+//      [--pc-samples file [--sample-interval cycles]] [rom]
+int main(int argc, char **argv) {
   mpu::CPU cpu;
+  // GBOY_TRACE builds: the last instructions are written here on the way
+  // out, error or not
+  std::string trace;
+  // and GBOY_PROFILE builds their opcode profile here
+  std::string profile;
+  // guest PC samples for gboy-pcprof, any build
+  std::string pc_samples;
+  auto save_reports = [&] {
+#ifdef GBOY_TRACE
+    if (!trace.empty())
+      cpu.trace.save(trace);
+#endif
+#ifdef GBOY_PROFILE
+    if (!profile.empty())
+      cpu.profile.save(profile);
+#endif
+    if (!pc_samples.empty())
+      cpu.sampler.save(pc_samples);
+  };
   try {
-    cpu.run();
-  } catch (std::runtime_error &error) {
+    std::string path;
+    std::string record;
+    bool record_audio = false;
+    std::string movie_record;
+    std::string movie_play;
+    mpu::u64 seek = 0;
+    std::string movie_verify;
+    unsigned jobs = 0;
+    bool rtc_catch_up = true;
+    mpu::u32 sample_interval = 1024;
+    [[maybe_unused]] mpu::u32 run_ahead = 0; // frontend only
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--run-ahead" && i + 1 < argc)
+        run_ahead = static_cast<mpu::u32>(std::stoul(argv[++i]));
+      else if (arg == "--record" && i + 1 < argc)
+        record = argv[++i];
+      else if (arg == "--record-audio")
+        record_audio = true;
+      else if (arg == "--movie-record" && i + 1 < argc)
+        movie_record = argv[++i];
+      else if (arg == "--movie-play" && i + 1 < argc)
+        movie_play = argv[++i];
+      else if (arg == "--seek" && i + 1 < argc)
+        seek = std::stoull(argv[++i]);
+      else if (arg == "--movie-verify" && i + 1 < argc)
+        movie_verify = argv[++i];
+      else if (arg == "--jobs" && i + 1 < argc)
+        jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+      else if (arg == "--rtc-guest")
+        rtc_catch_up = false; // the cart clock only runs with the game
+      else if (arg == "--trace" && i + 1 < argc)
+        trace = argv[++i];
+      else if (arg == "--profile" && i + 1 < argc)
+        profile = argv[++i];
+      else if (arg == "--pc-samples" && i + 1 < argc)
+        pc_samples = argv[++i];
+      else if (arg == "--sample-interval" && i + 1 < argc)
+        sample_interval = static_cast<mpu::u32>(std::stoul(argv[++i]));
+      else
+        path = arg;
+    }
+
+    // started after the frontend has picked the audio rate
+    std::unique_ptr<mpu::recorder> recording;
+    auto start_recording = [&] {
+      if (!record.empty())
+        recording = std::make_unique<mpu::recorder>(
+            cpu, record, mpu::recorder::format_of(record), record_audio);
+    };
+
+    if (!path.empty()) {
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+        throw mpu::mpu_runtime_error("cannot open " + path);
+      std::vector<mpu::u8> rom(std::istreambuf_iterator<char>(file), {});
+      cpu.get_bus().load_rom(rom);
+      // replays start from the RAM their movie recorded, never a save
+      if (movie_play.empty() && movie_verify.empty())
+        cpu.get_bus().cart.attach_save(
+            std::filesystem::path(path).replace_extension(".sav").string(),
+            rtc_catch_up);
+    }
+#ifndef GBOY_TRACE
+    if (!trace.empty())
+      throw mpu::mpu_runtime_error("--trace needs a GBOY_TRACE build");
+#endif
+#ifndef GBOY_PROFILE
+    if (!profile.empty())
+      throw mpu::mpu_runtime_error("--profile needs a GBOY_PROFILE build");
+#endif
+    if (!movie_verify.empty()) {
+      // every keyframe-to-keyframe segment on its own worker
+      const mpu::movie movie = mpu::movie::load(movie_verify);
+      const auto start = mpu::clk::now();
+      const auto segments = mpu::verify_movie(cpu.get_bus(), movie, jobs);
+      const std::chrono::duration<double> elapsed = mpu::clk::now() - start;
+
+      std::size_t bad = 0;
+      for (const auto &segment : segments) {
+        if (segment.ok())
+          continue;
+        ++bad;
+        std::cout << "desync in frames " << segment.first << "-"
+                  << segment.last << std::endl;
+      }
+      std::cout << segments.size() << " segments, " << bad << " desynced, "
+                << movie.frames << " frames in " << elapsed.count() << " s ("
+                << static_cast<double>(movie.frames) / elapsed.count()
+                << " frames/s)" << std::endl;
+      return bad ? 1 : 0;
+    }
+
+    mpu::movie replay;
+    std::unique_ptr<mpu::movie_player> player;
+    if (!movie_play.empty()) {
+      replay = mpu::movie::load(movie_play);
+      player = std::make_unique<mpu::movie_player>(cpu, replay);
+      if (seek)
+        std::cout << "seek to " << seek << ": replayed "
+                  << player->seek(seek) << " frames from a keyframe"
+                  << std::endl;
+    }
+    // after any seek, so the samples start where the run does
+    if (!pc_samples.empty())
+      cpu.sampler.start(sample_interval, cpu.get_bus().clock);
+
+#ifdef GBOY_SDL
+    gui::window frontend(cpu, 4, run_ahead);
+    std::unique_ptr<mpu::movie_recorder> recorder;
+    if (!movie_record.empty()) {
+      recorder = std::make_unique<mpu::movie_recorder>(cpu);
+      frontend.record(*recorder);
+    }
+    if (player)
+      frontend.play(*player);
+    start_recording();
+    const int status = frontend.run();
+    if (recording)
+      recording->stop();
+    cpu.get_bus().cart.persist(cpu.get_bus().clock);
+    save_reports();
+    if (recorder)
+      recorder->finish().save(movie_record);
+    return status;
+#else
+    if (!movie_record.empty())
+      throw mpu::mpu_runtime_error("--movie-record needs the SDL frontend");
+    start_recording();
+    if (player) {
+      // headless replay: as fast as possible, then check for desyncs
+      const auto start = mpu::clk::now();
+      while (!player->done()) {
+        cpu.get_bus().set_input(player->next());
+        cpu.run_frame();
+      }
+      const std::chrono::duration<double> elapsed = mpu::clk::now() - start;
+      if (recording)
+        recording->stop();
+      save_reports();
+      std::cout << player->frame() << " frames in " << elapsed.count()
+                << " s, " << (player->verify() ? "in sync" : "DESYNC")
+                << std::endl;
+      return player->verify() ? 0 : 1;
+    }
+    // until interrupted; then the save and reports go out as on any exit
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    cpu.run(stop_requested);
+    if (recording)
+      recording->stop();
+    cpu.get_bus().cart.persist(cpu.get_bus().clock);
+    save_reports();
+    return 0;
+#endif
+  } catch (std::exception &error) {
     std::cerr << error.what() << std::endl;
+    try {
+      save_reports();
+    } catch (std::exception &report_error) {
+      std::cerr << report_error.what() << std::endl;
+    }
+    return 1;
   }
-}
\ No newline at end of file
+}
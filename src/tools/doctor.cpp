@@ -0,0 +1,375 @@
+#include "core/cpu.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Lockstep comparison against gameboy-doctor logs: one line per executed
+ * instruction with the registers before it and the four bytes at pc,
+ *
+ *   A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+ *
+ * The log is mapped, never read into memory, and walked line by line while
+ * the core steps. Our state is rendered into the same fixed layout with a
+ * digit table and compared with memcmp; lines in any other spelling
+ * (lower case, missing PCMEM, other spacing) fall back to a field parser.
+ * The first difference stops the run with the preceding lines as context.
+ *
+ * Registers start from the log's first line and LY reads 0x90 throughout,
+ * as the logs assume (--real-ly turns that off).
+ *
+ * usage: gboy-doctor [--context N] [--real-ly] rom log
+ */
+
+namespace {
+using namespace mpu;
+
+constexpr char DIGITS[] = "0123456789ABCDEF";
+constexpr std::size_t RELEASE = 64u << 20; // mapped bytes dropped at a time
+
+auto os_error(const std::string &_what) -> mpu_runtime_error {
+  return mpu_runtime_error(_what + ": " + std::strerror(errno));
+}
+
+struct machine_state {
+  u8 a, f, b, c, d, e, h, l;
+  u16 sp, pc;
+  u8 pcmem[4];
+  bool has_pcmem = true;
+};
+
+// read-only view of the whole log; pages behind the cursor are handed
+// back to the kernel as it moves on
+struct mapped_log {
+  const char *data = nullptr;
+  std::size_t size = 0;
+  std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+  explicit mapped_log(const std::string &_path) {
+    const int fd = ::open(_path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw os_error("cannot open " + _path);
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw os_error("cannot stat " + _path);
+    }
+    size = static_cast<std::size_t>(info.st_size);
+    if (size) {
+      void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        ::close(fd);
+        throw os_error("cannot map " + _path);
+      }
+      data = static_cast<const char *>(map);
+      ::madvise(map, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+  }
+  ~mapped_log() {
+    if (data)
+      ::munmap(const_cast<char *>(data), size);
+  }
+  mapped_log(const mapped_log &) = delete;
+  mapped_log &operator=(const mapped_log &) = delete;
+
+  // drop pages well behind _offset; the context lines stay mapped.
+  // madvise works on whole pages, so _released stays page aligned.
+  auto release(std::size_t _offset, std::size_t &_released) const -> void {
+    if (_offset < _released + 2 * RELEASE)
+      return;
+    const std::size_t until = (_offset - RELEASE) / page * page;
+    if (::madvise(const_cast<char *>(data) + _released, until - _released,
+                  MADV_DONTNEED) != 0)
+      throw os_error("cannot release pages of the log");
+    _released = until;
+  }
+};
+
+auto hex2(char *_out, u8 _value) -> void {
+  _out[0] = DIGITS[_value >> 4];
+  _out[1] = DIGITS[_value & 0xF];
+}
+
+// our state in the canonical log layout; returns the length
+auto render(const machine_state &_state, char *_out) -> std::size_t {
+  char *at = _out;
+  const std::pair<const char *, u8> registers[] = {
+      {"A:", _state.a}, {" F:", _state.f}, {" B:", _state.b},
+      {" C:", _state.c}, {" D:", _state.d}, {" E:", _state.e},
+      {" H:", _state.h}, {" L:", _state.l}};
+  for (const auto &[label, value] : registers) {
+    const std::size_t length = std::strlen(label);
+    std::memcpy(at, label, length);
+    hex2(at + length, value);
+    at += length + 2;
+  }
+  std::memcpy(at, " SP:", 4);
+  hex2(at + 4, static_cast<u8>(_state.sp >> 8));
+  hex2(at + 6, static_cast<u8>(_state.sp));
+  std::memcpy(at + 8, " PC:", 4);
+  hex2(at + 12, static_cast<u8>(_state.pc >> 8));
+  hex2(at + 14, static_cast<u8>(_state.pc));
+  at += 16;
+  if (_state.has_pcmem) {
+    std::memcpy(at, " PCMEM:", 7);
+    at += 7;
+    for (int i = 0; i < 4; ++i) {
+      hex2(at, _state.pcmem[i]);
+      at[2] = ',';
+      at += 3;
+    }
+    --at; // no comma after the last byte
+  }
+  return static_cast<std::size_t>(at - _out);
+}
+
+auto capture(const CPU &_cpu) -> machine_state {
+  const mmu &bus = _cpu.get_bus();
+  machine_state state{_cpu.get_psw().A,  _cpu.get_psw().F, _cpu.get_bc().B,
+                      _cpu.get_bc().C,   _cpu.get_de().D,  _cpu.get_de().E,
+                      _cpu.get_hl().H,   _cpu.get_hl().L,  _cpu.get_sp().SP,
+                      _cpu.get_pc(),     {},               true};
+  for (u16 i = 0; i < 4; ++i)
+    state.pcmem[i] = bus.at(static_cast<u16>(state.pc + i));
+  return state;
+}
+
+auto digit(char _c) -> int {
+  if (_c >= '0' && _c <= '9')
+    return _c - '0';
+  _c = static_cast<char>(_c | 0x20);
+  return _c >= 'a' && _c <= 'f' ? _c - 'a' + 10 : -1;
+}
+
+// "KEY:hex" fields in any order or case; false if a register is missing
+auto parse(std::string_view _line, machine_state &_state) -> bool {
+  auto field = [&](std::string_view _key, unsigned &_value) {
+    for (std::size_t at = 0; (at = _line.find(_key, at)) != _line.npos;
+         at += _key.size()) {
+      // "C:" must not match inside "PC:"
+      if (at && std::isalpha(static_cast<unsigned char>(_line[at - 1])))
+        continue;
+      _value = 0;
+      std::size_t i = at + _key.size();
+      for (int d; i < _line.size() && (d = digit(_line[i])) >= 0; ++i)
+        _value = _value << 4 | static_cast<unsigned>(d);
+      return i > at + _key.size();
+    }
+    return false;
+  };
+
+  unsigned values[10];
+  const char *keys[] = {"A:", "F:", "B:", "C:", "D:",
+                        "E:", "H:", "L:", "SP:", "PC:"};
+  for (int i = 0; i < 10; ++i)
+    if (!field(keys[i], values[i]))
+      return false;
+  _state = {static_cast<u8>(values[0]),  static_cast<u8>(values[1]),
+            static_cast<u8>(values[2]),  static_cast<u8>(values[3]),
+            static_cast<u8>(values[4]),  static_cast<u8>(values[5]),
+            static_cast<u8>(values[6]),  static_cast<u8>(values[7]),
+            static_cast<u16>(values[8]), static_cast<u16>(values[9]),
+            {},                          false};
+
+  const std::size_t pcmem = _line.find("PCMEM:");
+  if (pcmem == _line.npos)
+    return true;
+  std::size_t at = pcmem + 6;
+  for (int i = 0; i < 4; ++i, at += 3) {
+    if (at + 2 > _line.size() || digit(_line[at]) < 0 ||
+        digit(_line[at + 1]) < 0)
+      return false;
+    _state.pcmem[i] = static_cast<u8>(digit(_line[at]) << 4 | digit(_line[at + 1]));
+  }
+  _state.has_pcmem = true;
+  return true;
+}
+
+auto same(const machine_state &_ours, const machine_state &_log) -> bool {
+  return _ours.a == _log.a && _ours.f == _log.f && _ours.b == _log.b &&
+         _ours.c == _log.c && _ours.d == _log.d && _ours.e == _log.e &&
+         _ours.h == _log.h && _ours.l == _log.l && _ours.sp == _log.sp &&
+         _ours.pc == _log.pc &&
+         (!_log.has_pcmem ||
+          std::equal(_ours.pcmem, _ours.pcmem + 4, _log.pcmem));
+}
+
+auto pending(const mmu &_bus) -> bool {
+  return _bus.interrupt_enable & _bus.io_regs[mmu::IF - 0xFF00] & 0x1F;
+}
+
+// step until one instruction has executed: interrupt dispatch and halted
+// time produce no log line
+auto execute_one(CPU &_cpu, u64 _limit) -> void {
+  mmu &bus = _cpu.get_bus();
+  const u64 start = bus.clock;
+  for (;;) {
+    const bool dispatch = _cpu.INTERRUPT_ENABLE && pending(bus);
+    const bool sleeping = _cpu.halted() && !pending(bus);
+    _cpu.step();
+    if (!dispatch && !sleeping)
+      return;
+    if (bus.clock - start > _limit)
+      throw mpu_runtime_error("halted for over a second without a wake-up");
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t context = 5;
+  bool stub_ly = true;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--context" && i + 1 < argc)
+      context = std::stoull(argv[++i]);
+    else if (arg == "--real-ly")
+      stub_ly = false;
+    else
+      paths.push_back(arg);
+  }
+  if (paths.size() != 2) {
+    std::cerr << "usage: gboy-doctor [--context N] [--real-ly] rom log"
+              << std::endl;
+    return 2;
+  }
+
+  try {
+    std::ifstream file(paths[0], std::ios::binary);
+    if (!file)
+      throw mpu_runtime_error("cannot open " + paths[0]);
+    const std::vector<u8> rom(std::istreambuf_iterator<char>(file), {});
+    const mapped_log log(paths[1]);
+
+    auto cpu = std::make_unique<CPU>();
+    mmu &bus = cpu->get_bus();
+    bus.load_rom(rom);
+    bus.video.stub_ly = stub_ly;
+    cpu->set_audio_enabled(false);
+    cpu->set_video_enabled(false);
+
+    // start of every line in a small ring, for the context printout
+    std::vector<std::size_t> starts(context + 1);
+    std::size_t released = 0;
+    u64 line = 0;
+    char ours[64];
+    std::string failure;
+    machine_state expected{}, state{};
+    std::string_view text;
+
+    const auto start = clk::now();
+    for (std::size_t at = 0; at < log.size;) {
+      const char *end =
+          static_cast<const char *>(std::memchr(log.data + at, '\n', log.size - at));
+      const std::size_t next = end ? end - log.data + 1 : log.size;
+      text = {log.data + at, next - at - (end ? 1 : 0)};
+      if (!text.empty() && text.back() == '\r')
+        text.remove_suffix(1);
+      if (text.empty()) {
+        at = next;
+        continue;
+      }
+      starts[line % starts.size()] = at;
+
+      if (line == 0) {
+        // the log's first line is where the core starts
+        if (!parse(text, expected))
+          throw mpu_runtime_error(paths[1] + ":1: not a gameboy-doctor line");
+        cpu->set_acc(expected.a);
+        cpu->set_flags(expected.f);
+        cpu->set_b(expected.b);
+        cpu->set_c(expected.c);
+        cpu->set_d(expected.d);
+        cpu->set_e(expected.e);
+        cpu->set_h(expected.h);
+        cpu->set_l(expected.l);
+        cpu->set_sp(expected.sp);
+        cpu->set_pc(expected.pc);
+      }
+
+      state = capture(*cpu);
+      const std::size_t length = render(state, ours);
+      if (text.size() != length || std::memcmp(text.data(), ours, length)) {
+        // not our spelling: compare field by field
+        if (!parse(text, expected)) {
+          failure = "cannot read the line";
+          break;
+        }
+        if (!same(state, expected)) {
+          failure = "state differs";
+          break;
+        }
+      }
+
+      ++line;
+      at = next;
+      log.release(at, released);
+      if (at < log.size) {
+        try {
+          execute_one(*cpu, apu::CLOCK_RATE);
+        } catch (std::exception &error) {
+          failure = std::string("core: ") + error.what();
+          // the next line is the one we could not reach
+          starts[line % starts.size()] = at;
+          const char *stop = static_cast<const char *>(
+              std::memchr(log.data + at, '\n', log.size - at));
+          text = {log.data + at,
+                  stop ? static_cast<std::size_t>(stop - (log.data + at))
+                       : log.size - at};
+          state = capture(*cpu);
+          break;
+        }
+      }
+    }
+    const std::chrono::duration<double> elapsed = clk::now() - start;
+
+    if (failure.empty()) {
+      std::cout << line << " lines match (" << log.size / 1e6 << " MB in "
+                << elapsed.count() << " s, "
+                << static_cast<double>(log.size) / 1e6 / elapsed.count()
+                << " MB/s)" << std::endl;
+      return 0;
+    }
+
+    // the matching lines before the divergence, then both sides of it
+    std::cout << "divergence at line " << line + 1 << ": " << failure << "\n";
+    const std::size_t shown = std::min<u64>(line, context);
+    for (std::size_t i = shown; i > 0; --i) {
+      const std::size_t from = starts[(line - i) % starts.size()];
+      const char *stop = static_cast<const char *>(
+          std::memchr(log.data + from, '\n', log.size - from));
+      std::string_view previous(log.data + from,
+                                stop ? stop - (log.data + from) : log.size - from);
+      if (!previous.empty() && previous.back() == '\r')
+        previous.remove_suffix(1);
+      std::cout << "  " << line + 1 - i << "  " << previous << "\n";
+    }
+    state.has_pcmem = text.find("PCMEM") != text.npos;
+    const std::string mine(ours, render(state, ours));
+    std::string marks(std::max(text.size(), mine.size()), ' ');
+    for (std::size_t i = 0; i < marks.size(); ++i)
+      if (i >= text.size() || i >= mine.size() ||
+          std::toupper(static_cast<unsigned char>(text[i])) != mine[i])
+        marks[i] = '^';
+    std::cout << "  log   " << text << "\n  core  " << mine << "\n        "
+              << marks << std::endl;
+    return 1;
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 2;
+  }
+}
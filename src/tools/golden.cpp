@@ -0,0 +1,183 @@
+#include "core/cpu.hpp"
+#include "core/frame_hash.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Regression runner over per-frame hash streams: every ROM runs headless
+ * for a fixed number of frames with no input, and the picture and RAM hash
+ * of each VBlank is compared with `<rom>.golden` next to it. Directories
+ * are searched for .gb/.gbc files. --update (re)writes the goldens.
+ *
+ * usage: gboy-golden [--frames N] [--jobs N] [--update] rom|dir...
+ */
+
+namespace {
+using namespace mpu;
+namespace fs = std::filesystem;
+
+enum class verdict : u8 { pass, fail, missing, updated, error };
+
+struct job {
+  fs::path rom;
+  verdict result = verdict::error;
+  std::string detail{};
+};
+
+auto run(job &_job, u64 _frames, bool _update) -> void {
+  std::ifstream file(_job.rom, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _job.rom.string());
+  const std::vector<u8> rom(std::istreambuf_iterator<char>(file), {});
+
+  frame_hashes stream;
+  auto cpu = std::make_unique<CPU>();
+  cpu->get_bus().load_rom(rom);
+  cpu->get_bus().hashes = &stream;
+  for (u64 frame = 0; frame < _frames; ++frame)
+    cpu->run_frame();
+
+  const std::string golden = _job.rom.string() + ".golden";
+  if (_update) {
+    stream.save(golden);
+    _job.result = verdict::updated;
+    return;
+  }
+  if (!fs::exists(golden)) {
+    _job.result = verdict::missing;
+    return;
+  }
+
+  const frame_hashes expected = frame_hashes::load(golden);
+  const long long at = stream.mismatch(expected);
+  if (at < 0) {
+    _job.result = verdict::pass;
+    return;
+  }
+
+  _job.result = verdict::fail;
+  const auto index = static_cast<std::size_t>(at);
+  if (index >= stream.digests.size() || index >= expected.digests.size()) {
+    _job.detail = std::to_string(stream.digests.size()) + " frames, golden has " +
+                  std::to_string(expected.digests.size());
+    return;
+  }
+  const frame_digest &ours = stream.digests[index];
+  const frame_digest &theirs = expected.digests[index];
+  _job.detail = "frame " + std::to_string(ours.frame) + ":";
+  if (ours.frame != theirs.frame)
+    _job.detail += " numbering";
+  if (ours.video != theirs.video)
+    _job.detail += " picture";
+  if (ours.memory != theirs.memory)
+    _job.detail += " memory";
+}
+
+auto collect(const fs::path &_path, std::vector<job> &_jobs) -> void {
+  if (!fs::is_directory(_path)) {
+    _jobs.push_back({.rom = _path});
+    return;
+  }
+  std::vector<fs::path> roms;
+  for (const auto &entry : fs::recursive_directory_iterator(_path)) {
+    const auto extension = entry.path().extension();
+    if (entry.is_regular_file() && (extension == ".gb" || extension == ".gbc"))
+      roms.push_back(entry.path());
+  }
+  std::sort(roms.begin(), roms.end());
+  for (const fs::path &rom : roms)
+    _jobs.push_back({.rom = rom});
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  u64 frames = 600;
+  unsigned threads = 0;
+  bool update = false;
+  std::vector<job> jobs;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--frames" && i + 1 < argc)
+        frames = std::stoull(argv[++i]);
+      else if (arg == "--jobs" && i + 1 < argc)
+        threads = static_cast<unsigned>(std::stoul(argv[++i]));
+      else if (arg == "--update")
+        update = true;
+      else
+        collect(arg, jobs);
+    }
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 2;
+  }
+  if (jobs.empty()) {
+    std::cerr << "usage: gboy-golden [--frames N] [--jobs N] [--update] "
+                 "rom|dir..."
+              << std::endl;
+    return 2;
+  }
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<unsigned>(threads, static_cast<unsigned>(jobs.size()));
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+      try {
+        run(jobs[i], frames, update);
+      } catch (std::exception &error) {
+        jobs[i].result = verdict::error;
+        jobs[i].detail = error.what();
+      }
+    }
+  };
+
+  const auto start = clk::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &thread : pool)
+    thread.join();
+  const std::chrono::duration<double> elapsed = clk::now() - start;
+
+  std::size_t counts[5] = {};
+  for (const job &j : jobs) {
+    ++counts[static_cast<std::size_t>(j.result)];
+    switch (j.result) {
+    case verdict::fail:
+      std::cout << "FAIL    " << j.rom.string() << ": " << j.detail << "\n";
+      break;
+    case verdict::missing:
+      std::cout << "MISSING " << j.rom.string() << ".golden\n";
+      break;
+    case verdict::error:
+      std::cout << "ERROR   " << j.rom.string() << ": " << j.detail << "\n";
+      break;
+    default:
+      break;
+    }
+  }
+  std::cout << jobs.size() << " roms, " << frames << " frames each: "
+            << counts[static_cast<std::size_t>(verdict::pass)] << " passed, "
+            << counts[static_cast<std::size_t>(verdict::fail)] << " failed, "
+            << counts[static_cast<std::size_t>(verdict::missing)]
+            << " missing, " << counts[static_cast<std::size_t>(verdict::error)]
+            << " errors, " << counts[static_cast<std::size_t>(verdict::updated)]
+            << " updated in " << elapsed.count() << " s" << std::endl;
+
+  const bool clean = counts[static_cast<std::size_t>(verdict::pass)] +
+                         counts[static_cast<std::size_t>(verdict::updated)] ==
+                     jobs.size();
+  return clean ? 0 : 1;
+}
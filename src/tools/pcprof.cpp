@@ -0,0 +1,171 @@
+#include "core/apu.hpp"
+#include "core/sampler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Ranked report of the guest PC samples written by `gboy --pc-samples
+ * file`: guest routines ordered by the share of samples that landed in
+ * them, then the hottest individual addresses.
+ *
+ * Addresses resolve against RGBDS or no$gmb symbol files ("bank:address
+ * name" lines) to the nearest symbol at or below them in the same bank and
+ * memory region; without one they are listed as bank:pc.
+ *
+ * usage: gboy-pcprof [--sym file.sym]... [--top N] samples
+ */
+
+namespace {
+using namespace mpu;
+
+// start of the memory region holding _address; symbols never resolve
+// across one, so a routine does not swallow the data after it
+auto region(u16 _address) -> u16 {
+  if (_address < 0x4000)
+    return 0x0000;
+  if (_address < 0x8000)
+    return 0x4000;
+  if (_address < 0xA000)
+    return 0x8000;
+  if (_address < 0xC000)
+    return 0xA000;
+  if (_address < 0xE000)
+    return 0xC000;
+  return _address < 0xFF80 ? 0xE000 : 0xFF80;
+}
+
+struct symbols {
+  // bank << 16 | address; banks only tell ROM banks apart, RAM symbols
+  // are kept under bank 0 whatever bank the assembler gave them
+  std::map<u32, std::string> names;
+
+  static auto key(u16 _bank, u16 _address) -> u32 {
+    return static_cast<u32>(_address < 0x8000 ? _bank : 0) << 16 | _address;
+  }
+
+  auto load(const std::string &_path) -> void {
+    std::ifstream file(_path);
+    if (!file)
+      throw mpu_runtime_error("cannot open " + _path);
+    std::string line;
+    while (std::getline(file, line)) {
+      // comments, and the [labels] style section headers of no$gmb
+      const std::size_t start = line.find_first_not_of(" \t");
+      if (start == std::string::npos || line[start] == ';' ||
+          line[start] == '[')
+        continue;
+      unsigned bank, address;
+      char name[256];
+      if (std::sscanf(line.c_str() + start, "%x:%x %255s", &bank, &address,
+                      name) != 3)
+        throw mpu_runtime_error(_path + ": expected bank:address name, got " +
+                                line);
+      names[key(static_cast<u16>(bank), static_cast<u16>(address))] = name;
+    }
+  }
+
+  // "name" or "name+0x12", empty when nothing precedes the address
+  auto resolve(u16 _bank, u16 _pc) const -> std::string {
+    const u32 at = key(_bank, _pc);
+    auto found = names.upper_bound(at);
+    if (found == names.begin())
+      return {};
+    --found;
+    const u16 address = static_cast<u16>(found->first);
+    if (found->first >> 16 != at >> 16 || region(address) != region(_pc))
+      return {};
+    if (address == _pc)
+      return found->second;
+    char offset[8];
+    std::snprintf(offset, sizeof(offset), "+0x%x", _pc - address);
+    return found->second + offset;
+  }
+};
+
+auto location(u16 _bank, u16 _pc) -> std::string {
+  char text[16];
+  std::snprintf(text, sizeof(text), "%02x:%04x", _bank, _pc);
+  return text;
+}
+
+auto percent(u64 _count, u64 _total) -> double {
+  return _total ? 100.0 * static_cast<double>(_count) /
+                      static_cast<double>(_total)
+                : 0.0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> symbol_files;
+  std::size_t top = 20;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--sym" && i + 1 < argc)
+      symbol_files.push_back(argv[++i]);
+    else if (arg == "--top" && i + 1 < argc)
+      top = std::stoull(argv[++i]);
+    else
+      path = arg;
+  }
+  if (path.empty()) {
+    std::cerr << "usage: gboy-pcprof [--sym file.sym]... [--top N] samples"
+              << std::endl;
+    return 2;
+  }
+
+  try {
+    symbols table;
+    for (const std::string &file : symbol_files)
+      table.load(file);
+    u32 interval = 1;
+    const std::vector<pc_sampler::sample> samples =
+        pc_sampler::load(path, interval);
+
+    u64 total = 0;
+    std::map<std::string, u64> routines;
+    std::vector<std::string> names;
+    names.reserve(samples.size());
+    for (const auto &at : samples) {
+      total += at.count;
+      std::string name = table.resolve(at.bank, at.pc);
+      // unresolved addresses stand alone
+      routines[name.empty() ? location(at.bank, at.pc)
+                            : name.substr(0, name.find('+'))] += at.count;
+      names.push_back(std::move(name));
+    }
+    std::vector<std::pair<std::string, u64>> ranked(routines.begin(),
+                                                    routines.end());
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto &_a, const auto &_b) {
+                       return _a.second > _b.second;
+                     });
+
+    std::printf("%llu samples every %u T-cycles, %.2f s of guest time\n\n",
+                static_cast<unsigned long long>(total), interval,
+                static_cast<double>(total) * interval / apu::CLOCK_RATE);
+    std::printf("%7s  %10s  routine\n", "share", "samples");
+    for (std::size_t i = 0; i < ranked.size() && i < top; ++i)
+      std::printf("%6.2f%%  %10llu  %s\n", percent(ranked[i].second, total),
+                  static_cast<unsigned long long>(ranked[i].second),
+                  ranked[i].first.c_str());
+
+    // samples come sorted by count
+    std::printf("\n%7s  %10s  %-7s  address\n", "share", "samples", "bank:pc");
+    for (std::size_t i = 0; i < samples.size() && i < top; ++i)
+      std::printf("%6.2f%%  %10llu  %s  %s\n",
+                  percent(samples[i].count, total),
+                  static_cast<unsigned long long>(samples[i].count),
+                  location(samples[i].bank, samples[i].pc).c_str(),
+                  names[i].c_str());
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
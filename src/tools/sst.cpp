@@ -0,0 +1,399 @@
+#include "core/cpu.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * SM83 single-step test runner: loads the community per-opcode JSON test
+ * vectors (one file per opcode, e.g. "3e.json" or "cb 11.json", each an
+ * array of {name, initial, final, cycles} cases), runs every case through
+ * CPU::execute_instruction on a flat 64 KiB bus (GBOY_FLAT_BUS build of the
+ * core) and compares registers, IME, IE, touched memory and the M-cycle
+ * count.
+ *
+ * Files are sharded over a thread pool; the per-opcode table lists the
+ * failing opcodes with the first difference found.
+ *
+ * usage: gboy-sst [--jobs N] [--ignore-timing] file.json|dir...
+ */
+
+namespace {
+using namespace mpu;
+namespace fs = std::filesystem;
+
+struct cpu_state {
+  u16 pc = 0, sp = 0;
+  u8 a = 0, f = 0, b = 0, c = 0, d = 0, e = 0, h = 0, l = 0;
+  u8 ime = 0, ie = 0;
+  std::vector<std::pair<u16, u8>> ram;
+};
+
+struct test_case {
+  std::string name;
+  cpu_state initial;
+  cpu_state final;
+  u32 cycles = 0; // M-cycles
+};
+
+// just enough JSON for the test vectors; unknown keys are skipped
+struct json_reader {
+  const char *at;
+  const char *end;
+
+  auto fail(const char *_what) const -> mpu_runtime_error {
+    return mpu_runtime_error(std::string("bad test JSON: ") + _what);
+  }
+
+  auto peek() -> char {
+    while (at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t'))
+      ++at;
+    if (at == end)
+      throw fail("unexpected end");
+    return *at;
+  }
+
+  auto expect(char _c) -> void {
+    if (peek() != _c)
+      throw fail("unexpected character");
+    ++at;
+  }
+
+  // consumes _c if it comes next
+  auto next_is(char _c) -> bool {
+    if (peek() != _c)
+      return false;
+    ++at;
+    return true;
+  }
+
+  auto number() -> u64 {
+    peek();
+    u64 value = 0;
+    const char *start = at;
+    while (at < end && *at >= '0' && *at <= '9')
+      value = value * 10 + static_cast<u64>(*at++ - '0');
+    if (at == start)
+      throw fail("expected a number");
+    return value;
+  }
+
+  auto string() -> std::string_view {
+    expect('"');
+    const char *start = at;
+    while (at < end && *at != '"')
+      at += *at == '\\' ? 2 : 1;
+    if (at >= end)
+      throw fail("unterminated string");
+    return {start, static_cast<std::size_t>(at++ - start)};
+  }
+
+  // calls _item for each element; the reader sits on the element
+  template <typename F> auto array(F &&_item) -> void {
+    expect('[');
+    if (next_is(']'))
+      return;
+    do
+      _item();
+    while (next_is(','));
+    expect(']');
+  }
+
+  template <typename F> auto object(F &&_member) -> void {
+    expect('{');
+    if (next_is('}'))
+      return;
+    do {
+      const std::string_view key = string();
+      expect(':');
+      _member(key);
+    } while (next_is(','));
+    expect('}');
+  }
+
+  auto skip() -> void {
+    const char c = peek();
+    if (c == '{')
+      object([&](std::string_view) { skip(); });
+    else if (c == '[')
+      array([&] { skip(); });
+    else if (c == '"')
+      string();
+    else
+      while (at < end && *at != ',' && *at != '}' && *at != ']')
+        ++at;
+  }
+};
+
+auto parse_state(json_reader &_in, cpu_state &_state) -> void {
+  _in.object([&](std::string_view _key) {
+    if (_key == "ram") {
+      _in.array([&] {
+        u16 addr = 0;
+        u8 value = 0;
+        int field = 0;
+        _in.array([&] {
+          if (field++ == 0)
+            addr = static_cast<u16>(_in.number());
+          else
+            value = static_cast<u8>(_in.number());
+        });
+        _state.ram.emplace_back(addr, value);
+      });
+      return;
+    }
+    if (_key == "pc")
+      _state.pc = static_cast<u16>(_in.number());
+    else if (_key == "sp")
+      _state.sp = static_cast<u16>(_in.number());
+    else if (_key.size() == 1 && std::string_view("afbcdehl").find(_key[0]) !=
+                                     std::string_view::npos) {
+      u8 *const registers[] = {&_state.a, &_state.f, &_state.b, &_state.c,
+                               &_state.d, &_state.e, &_state.h, &_state.l};
+      *registers[std::string_view("afbcdehl").find(_key[0])] =
+          static_cast<u8>(_in.number());
+    } else if (_key == "ime")
+      _state.ime = static_cast<u8>(_in.number());
+    else if (_key == "ie")
+      _state.ie = static_cast<u8>(_in.number());
+    else
+      _in.skip();
+  });
+}
+
+auto parse(const std::string &_text) -> std::vector<test_case> {
+  json_reader in{_text.data(), _text.data() + _text.size()};
+  std::vector<test_case> cases;
+  in.array([&] {
+    test_case &test = cases.emplace_back();
+    in.object([&](std::string_view _key) {
+      if (_key == "name")
+        test.name = in.string();
+      else if (_key == "initial")
+        parse_state(in, test.initial);
+      else if (_key == "final")
+        parse_state(in, test.final);
+      else if (_key == "cycles")
+        in.array([&] {
+          ++test.cycles;
+          in.skip();
+        });
+      else
+        in.skip();
+    });
+  });
+  return cases;
+}
+
+struct result {
+  fs::path file;
+  std::size_t cases = 0;
+  std::size_t failed = 0;
+  std::size_t timing = 0; // failed on the cycle count alone
+  std::string first{};    // first failure
+};
+
+auto hex(unsigned _value) -> std::string {
+  char text[8];
+  std::snprintf(text, sizeof(text), "%02x", _value);
+  return text;
+}
+
+// difference between the machine and _expected, empty if they agree
+auto compare(const CPU &_cpu, u16 _pc, const cpu_state &_expected)
+    -> std::string {
+  const auto &bus = _cpu.get_bus();
+  const struct {
+    const char *name;
+    unsigned ours;
+    unsigned theirs;
+  } fields[] = {
+      {"a", _cpu.get_psw().A, _expected.a},
+      {"f", _cpu.get_psw().F, _expected.f},
+      {"b", _cpu.get_bc().B, _expected.b},
+      {"c", _cpu.get_bc().C, _expected.c},
+      {"d", _cpu.get_de().D, _expected.d},
+      {"e", _cpu.get_de().E, _expected.e},
+      {"h", _cpu.get_hl().H, _expected.h},
+      {"l", _cpu.get_hl().L, _expected.l},
+      {"sp", _cpu.get_sp().SP, _expected.sp},
+      {"pc", _pc, _expected.pc},
+      {"ime", _cpu.INTERRUPT_ENABLE, _expected.ime},
+      {"ie", bus.flat[0xFFFF], _expected.ie},
+  };
+  for (const auto &field : fields)
+    if (field.ours != field.theirs)
+      return std::string(field.name) + " " + hex(field.ours) +
+             " != " + hex(field.theirs);
+  for (const auto &[addr, value] : _expected.ram)
+    if (bus.flat[addr] != value)
+      return "[" + hex(addr) + "] " + hex(bus.flat[addr]) + " != " + hex(value);
+  return {};
+}
+
+auto run_file(result &_result, bool _timing) -> void {
+  std::ifstream file(_result.file, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _result.file.string());
+  const std::string text(std::istreambuf_iterator<char>(file), {});
+  const std::vector<test_case> cases = parse(text);
+  _result.cases = cases.size();
+
+  // "cb 11.json" -> 0xCB, "3e.json" -> 0x3E
+  const u8 opcode =
+      static_cast<u8>(std::stoul(_result.file.stem().string(), nullptr, 16));
+
+  // the vectors come in two conventions: the opcode at pc, or already
+  // fetched (at pc - 1) with pc ending one past the next opcode
+  std::size_t fetched = 0;
+  for (const test_case &test : cases)
+    for (const auto &[addr, value] : test.initial.ram)
+      if (addr == static_cast<u16>(test.initial.pc - 1) && value == opcode)
+        ++fetched;
+  const bool prefetch = fetched * 2 > cases.size();
+
+  auto cpu = std::make_unique<CPU>();
+  auto &bus = cpu->get_bus();
+  for (const test_case &test : cases) {
+    const cpu_state &in = test.initial;
+    cpu->set_acc(in.a);
+    cpu->set_flags(in.f);
+    cpu->set_b(in.b);
+    cpu->set_c(in.c);
+    cpu->set_d(in.d);
+    cpu->set_e(in.e);
+    cpu->set_h(in.h);
+    cpu->set_l(in.l);
+    cpu->set_sp(in.sp);
+    cpu->INTERRUPT_ENABLE = in.ime;
+    // the flat bus has no IE register of its own, 0xFFFF is plain memory
+    bus.flat[0xFFFF] = in.ie;
+    for (const auto &[addr, value] : in.ram)
+      bus.flat[addr] = value;
+
+    const u16 from = prefetch ? static_cast<u16>(in.pc - 1) : in.pc;
+    cpu->set_pc(static_cast<u16>(from + 1));
+    std::string failure;
+    try {
+      cpu->execute_instruction(opcode);
+      const u16 pc = prefetch ? static_cast<u16>(cpu->get_pc() + 1)
+                              : cpu->get_pc();
+      failure = compare(*cpu, pc, test.final);
+      const u32 cycles =
+          CPU::instruction_cycles(opcode, from, cpu->get_pc()) / 4;
+      if (failure.empty() && _timing && cycles != test.cycles) {
+        failure = "cycles " + std::to_string(cycles) +
+                  " != " + std::to_string(test.cycles);
+        ++_result.timing;
+      }
+    } catch (std::exception &error) {
+      failure = error.what();
+    }
+
+    if (!failure.empty() && _result.failed++ == 0)
+      _result.first = test.name + ": " + failure;
+
+    // only what the vectors touch needs clearing for the next case
+    bus.flat[0xFFFF] = 0;
+    for (const auto &[addr, value] : in.ram)
+      bus.flat[addr] = 0;
+    for (const auto &[addr, value] : test.final.ram)
+      bus.flat[addr] = 0;
+  }
+}
+
+auto collect(const fs::path &_path, std::vector<result> &_results) -> void {
+  if (!fs::is_directory(_path)) {
+    _results.push_back({.file = _path});
+    return;
+  }
+  std::vector<fs::path> files;
+  for (const auto &entry : fs::directory_iterator(_path))
+    if (entry.is_regular_file() && entry.path().extension() == ".json")
+      files.push_back(entry.path());
+  std::sort(files.begin(), files.end());
+  for (const fs::path &file : files)
+    _results.push_back({.file = file});
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  unsigned threads = 0;
+  bool timing = true;
+  std::vector<result> results;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--jobs" && i + 1 < argc)
+        threads = static_cast<unsigned>(std::stoul(argv[++i]));
+      else if (arg == "--ignore-timing")
+        timing = false;
+      else
+        collect(arg, results);
+    }
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 2;
+  }
+  if (results.empty()) {
+    std::cerr << "usage: gboy-sst [--jobs N] [--ignore-timing] "
+                 "file.json|dir..."
+              << std::endl;
+    return 2;
+  }
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<unsigned>(threads, static_cast<unsigned>(results.size()));
+
+  // one opcode file per work item, pulled in order
+  std::atomic<std::size_t> next{0};
+  auto worker = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < results.size();) {
+      try {
+        run_file(results[i], timing);
+      } catch (std::exception &error) {
+        results[i].failed = results[i].cases = std::max<std::size_t>(
+            results[i].cases, 1);
+        results[i].first = error.what();
+      }
+    }
+  };
+
+  const auto start = clk::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &thread : pool)
+    thread.join();
+  const std::chrono::duration<double> elapsed = clk::now() - start;
+
+  std::size_t cases = 0, failed = 0, timing_only = 0, files_failed = 0;
+  for (const result &r : results) {
+    cases += r.cases;
+    failed += r.failed;
+    timing_only += r.timing;
+    if (!r.failed)
+      continue;
+    ++files_failed;
+    std::cout << r.file.stem().string() << "\t" << r.failed << "/" << r.cases
+              << " failed\t" << r.first << "\n";
+  }
+  std::cout << results.size() << " opcodes (" << files_failed << " failing), "
+            << cases << " cases: " << cases - failed << " passed, " << failed
+            << " failed (" << timing_only << " on timing only) in "
+            << elapsed.count() << " s on " << threads << " threads ("
+            << static_cast<double>(cases) / elapsed.count() << " cases/s)"
+            << std::endl;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+#include "core/cpu.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Headless test-ROM harness for blargg and mooneye style suites. Each ROM
+ * runs without audio or pixels until it reports a result or a guest-time
+ * limit runs out:
+ *
+ *  - mooneye: LD B,B executed with B/C/D/E/H/L = 3/5/8/13/21/34 passes,
+ *    0x42 in all of them fails;
+ *  - blargg: text sent over the serial port containing "Passed" or
+ *    "Failed", or the result block at 0xA000 (status, then DE B0 61) for
+ *    ROMs that do not print.
+ *
+ * Directories are searched for .gb/.gbc files and run in parallel; the
+ * table lists the verdict, guest and host time of every ROM.
+ *
+ * usage: gboy-testrom [--timeout guest-seconds] [--jobs N] [--serial]
+ *                     rom|dir...
+ */
+
+namespace {
+using namespace mpu;
+namespace fs = std::filesystem;
+
+constexpr u8 LD_B_B = 0x40;
+
+enum class verdict : u8 { pass, fail, timeout, error };
+
+struct job {
+  fs::path rom;
+  verdict result = verdict::error;
+  std::string serial{}; // bytes the ROM sent
+  std::string detail{};
+  double guest = 0.0; // seconds of Game Boy time
+  double host = 0.0;  // seconds of wall time
+};
+
+auto name(verdict _verdict) -> const char * {
+  switch (_verdict) {
+  case verdict::pass:
+    return "PASS";
+  case verdict::fail:
+    return "FAIL";
+  case verdict::timeout:
+    return "TIMEOUT";
+  default:
+    return "ERROR";
+  }
+}
+
+auto registers(const CPU &_cpu) -> std::string {
+  char text[64];
+  std::snprintf(text, sizeof(text), "B=%02x C=%02x D=%02x E=%02x H=%02x L=%02x",
+                _cpu.get_bc().B, _cpu.get_bc().C, _cpu.get_de().D,
+                _cpu.get_de().E, _cpu.get_hl().H, _cpu.get_hl().L);
+  return text;
+}
+
+// mooneye's verdict, once LD B,B has run
+auto fibonacci(const CPU &_cpu, job &_job) -> bool {
+  const u8 values[] = {_cpu.get_bc().B, _cpu.get_bc().C, _cpu.get_de().D,
+                       _cpu.get_de().E, _cpu.get_hl().H, _cpu.get_hl().L};
+  const u8 pass[] = {3, 5, 8, 13, 21, 34};
+  if (std::equal(std::begin(values), std::end(values), std::begin(pass))) {
+    _job.result = verdict::pass;
+    return true;
+  }
+  if (std::all_of(std::begin(values), std::end(values),
+                  [](u8 _value) { return _value == 0x42; })) {
+    _job.result = verdict::fail;
+    _job.detail = registers(_cpu);
+    return true;
+  }
+  return false; // an LD B,B that is not the final breakpoint
+}
+
+// blargg's text verdict
+auto serial_verdict(job &_job) -> bool {
+  if (_job.serial.find("Passed") != std::string::npos) {
+    _job.result = verdict::pass;
+    return true;
+  }
+  if (_job.serial.find("Failed") != std::string::npos) {
+    _job.result = verdict::fail;
+    return true;
+  }
+  return false;
+}
+
+// blargg's memory verdict: 0x80 while running, then the result code
+auto memory_verdict(const mmu &_bus, job &_job) -> bool {
+  const auto ram = _bus.cart.ram();
+  if (ram.size() < 4 || ram[1] != 0xDE || ram[2] != 0xB0 || ram[3] != 0x61 ||
+      ram[0] == 0x80)
+    return false;
+  _job.result = ram[0] == 0 ? verdict::pass : verdict::fail;
+  if (ram[0])
+    _job.detail = "result code " + std::to_string(ram[0]);
+  return true;
+}
+
+auto run(job &_job, u64 _limit) -> void {
+  std::ifstream file(_job.rom, std::ios::binary);
+  if (!file)
+    throw mpu_runtime_error("cannot open " + _job.rom.string());
+  const std::vector<u8> rom(std::istreambuf_iterator<char>(file), {});
+
+  auto cpu = std::make_unique<CPU>();
+  auto &bus = cpu->get_bus();
+  bus.load_rom(rom);
+  cpu->set_audio_enabled(false);
+  cpu->set_video_enabled(false);
+
+  // a transfer starts whenever SC is written with 0x81, which reschedules
+  // the port; the byte in SB at that point is what the ROM sent
+  u64 transfer = serial::IDLE;
+  u64 next_check = 0;
+  bool done = false;
+  while (!done && bus.clock < _limit) {
+    const u16 pc = cpu->get_pc();
+    const bool ld_b_b = !cpu->halted() && bus.at(pc) == LD_B_B;
+    cpu->step();
+
+    if (ld_b_b && cpu->get_pc() == static_cast<u16>(pc + 1))
+      done = fibonacci(*cpu, _job);
+
+    if ((bus.link.control & 0x81) == 0x81 && bus.link.next_event != transfer) {
+      _job.serial += static_cast<char>(bus.link.data);
+      done = done || serial_verdict(_job);
+    }
+    transfer = bus.link.next_event;
+
+    if (bus.clock >= next_check) {
+      next_check = bus.clock + ppu::FRAME_CYCLES;
+      done = done || memory_verdict(bus, _job);
+    }
+  }
+  if (!done)
+    _job.result = verdict::timeout;
+  _job.guest = static_cast<double>(bus.clock) / apu::CLOCK_RATE;
+}
+
+auto collect(const fs::path &_path, std::vector<job> &_jobs) -> void {
+  if (!fs::is_directory(_path)) {
+    _jobs.push_back({.rom = _path});
+    return;
+  }
+  std::vector<fs::path> roms;
+  for (const auto &entry : fs::recursive_directory_iterator(_path)) {
+    const auto extension = entry.path().extension();
+    if (entry.is_regular_file() && (extension == ".gb" || extension == ".gbc"))
+      roms.push_back(entry.path());
+  }
+  std::sort(roms.begin(), roms.end());
+  for (const fs::path &rom : roms)
+    _jobs.push_back({.rom = rom});
+}
+
+// last non-empty line of what the ROM printed
+auto last_line(const std::string &_text) -> std::string {
+  const std::size_t end = _text.find_last_not_of("\n\r ");
+  if (end == std::string::npos)
+    return {};
+  const std::size_t newline = _text.find_last_of('\n', end);
+  const std::size_t start = newline == std::string::npos ? 0 : newline + 1;
+  return _text.substr(start, end + 1 - start);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  double timeout = 120.0;
+  unsigned threads = 0;
+  bool show_serial = false;
+  std::vector<job> jobs;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg == "--timeout" && i + 1 < argc)
+        timeout = std::stod(argv[++i]);
+      else if (arg == "--jobs" && i + 1 < argc)
+        threads = static_cast<unsigned>(std::stoul(argv[++i]));
+      else if (arg == "--serial")
+        show_serial = true;
+      else
+        collect(arg, jobs);
+    }
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 2;
+  }
+  if (jobs.empty()) {
+    std::cerr << "usage: gboy-testrom [--timeout guest-seconds] [--jobs N] "
+                 "[--serial] rom|dir..."
+              << std::endl;
+    return 2;
+  }
+  const auto limit = static_cast<u64>(timeout * apu::CLOCK_RATE);
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<unsigned>(threads, static_cast<unsigned>(jobs.size()));
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+      const auto start = clk::now();
+      try {
+        run(jobs[i], limit);
+      } catch (std::exception &error) {
+        jobs[i].result = verdict::error;
+        jobs[i].detail = error.what();
+      }
+      jobs[i].host = std::chrono::duration<double>(clk::now() - start).count();
+    }
+  };
+
+  const auto start = clk::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &thread : pool)
+    thread.join();
+  const std::chrono::duration<double> elapsed = clk::now() - start;
+
+  std::size_t width = 0;
+  for (const job &j : jobs)
+    width = std::max(width, j.rom.string().size());
+
+  std::size_t passed = 0;
+  for (const job &j : jobs) {
+    passed += j.result == verdict::pass;
+    std::string detail = j.detail;
+    if (detail.empty() && j.result != verdict::pass)
+      detail = last_line(j.serial);
+
+    std::printf("%-*s  %-7s %8.2f s guest %7.3f s host  %s\n",
+                static_cast<int>(width), j.rom.string().c_str(), name(j.result),
+                j.guest, j.host, detail.c_str());
+    if (show_serial && !j.serial.empty() && j.result != verdict::pass)
+      std::printf("%s\n", j.serial.c_str());
+  }
+  std::cout << passed << "/" << jobs.size() << " passed in " << elapsed.count()
+            << " s on " << threads << " threads" << std::endl;
+  return passed == jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+#include "core/trace.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/**
+ * Offline decoder for instruction traces written by `gboy --trace file` in
+ * a GBOY_TRACE build: one line per instruction with the bus clock,
+ * bank:pc, the instruction bytes, their disassembly and the registers the
+ * instruction started from, oldest first.
+ *
+ * Traces keep no operand bytes for code running from ROM; with --rom they
+ * are read from the image, otherwise those operands print as "?".
+ *
+ * usage: gboy-trace [--rom file.gb] [--last N] file
+ */
+
+namespace {
+using namespace mpu;
+
+constexpr const char *R8[] = {"B", "C", "D", "E", "H", "L", "[HL]", "A"};
+constexpr const char *R16[] = {"BC", "DE", "HL", "SP"};
+constexpr const char *R16_AF[] = {"BC", "DE", "HL", "AF"};
+constexpr const char *CONDITION[] = {"NZ", "Z", "NC", "C"};
+constexpr const char *ALU[] = {"ADD", "ADC", "SUB", "SBC",
+                               "AND", "XOR", "OR",  "CP"};
+constexpr const char *SHIFT[] = {"RLC", "RRC", "RL",   "RR",
+                                 "SLA", "SRA", "SWAP", "SRL"};
+constexpr const char *ACCUMULATOR[] = {"RLCA", "RRCA", "RLA", "RRA",
+                                       "DAA",  "CPL",  "SCF", "CCF"};
+
+auto hex(unsigned _value, int _width) -> std::string {
+  char text[8];
+  std::snprintf(text, sizeof(text), "%0*x", _width, _value);
+  return "0x" + std::string(text);
+}
+
+struct instruction {
+  std::string text;
+  u8 length;
+};
+
+// mnemonic of the instruction at _pc, decoded from the opcode's bit fields;
+// _operands is null when they are not known
+auto disassemble(u8 _opcode, const u8 *_operands, u16 _pc) -> instruction {
+  const u8 x = _opcode >> 6, y = _opcode >> 3 & 7, z = _opcode & 7;
+  const u8 p = y >> 1, q = y & 1;
+  const u8 none[2] = {};
+  const u8 *bytes = _operands ? _operands : none;
+  const std::string n8 = _operands ? hex(bytes[0], 2) : "?";
+  const std::string n16 = _operands ? hex(bytes[0] | bytes[1] << 8, 4) : "?";
+  const std::string relative =
+      _operands ? hex(static_cast<u16>(_pc + 2 + static_cast<signed char>(
+                                                     bytes[0])),
+                      4)
+                : "?";
+  const std::string signed_n8 =
+      _operands ? std::to_string(static_cast<signed char>(bytes[0])) : "?";
+
+  if (x == 1)
+    return {_opcode == 0x76 ? "HALT"
+                            : std::string("LD ") + R8[y] + ", " + R8[z],
+            1};
+  if (x == 2)
+    return {std::string(ALU[y]) + " A, " + R8[z], 1};
+
+  if (x == 0)
+    switch (z) {
+    case 0:
+      if (y == 0)
+        return {"NOP", 1};
+      if (y == 1)
+        return {"LD [" + n16 + "], SP", 3};
+      if (y == 2)
+        return {"STOP", 2};
+      if (y == 3)
+        return {"JR " + relative, 2};
+      return {std::string("JR ") + CONDITION[y - 4] + ", " + relative, 2};
+    case 1:
+      if (q == 0)
+        return {std::string("LD ") + R16[p] + ", " + n16, 3};
+      return {std::string("ADD HL, ") + R16[p], 1};
+    case 2: {
+      const char *pointer[] = {"[BC]", "[DE]", "[HL+]", "[HL-]"};
+      return {q == 0 ? std::string("LD ") + pointer[p] + ", A"
+                     : std::string("LD A, ") + pointer[p],
+              1};
+    }
+    case 3:
+      return {std::string(q ? "DEC " : "INC ") + R16[p], 1};
+    case 4:
+      return {std::string("INC ") + R8[y], 1};
+    case 5:
+      return {std::string("DEC ") + R8[y], 1};
+    case 6:
+      return {std::string("LD ") + R8[y] + ", " + n8, 2};
+    default:
+      return {ACCUMULATOR[y], 1};
+    }
+
+  switch (z) {
+  case 0:
+    if (y < 4)
+      return {std::string("RET ") + CONDITION[y], 1};
+    if (y == 4)
+      return {"LDH [" + n8 + "], A", 2};
+    if (y == 5)
+      return {"ADD SP, " + signed_n8, 2};
+    if (y == 6)
+      return {"LDH A, [" + n8 + "]", 2};
+    return {"LD HL, SP + " + signed_n8, 2};
+  case 1:
+    if (q == 0)
+      return {std::string("POP ") + R16_AF[p], 1};
+    return {p == 0 ? "RET" : p == 1 ? "RETI" : p == 2 ? "JP HL" : "LD SP, HL",
+            1};
+  case 2:
+    if (y < 4)
+      return {std::string("JP ") + CONDITION[y] + ", " + n16, 3};
+    if (y == 4)
+      return {"LD [C], A", 1};
+    if (y == 5)
+      return {"LD [" + n16 + "], A", 3};
+    if (y == 6)
+      return {"LD A, [C]", 1};
+    return {"LD A, [" + n16 + "]", 3};
+  case 3:
+    if (y == 0)
+      return {"JP " + n16, 3};
+    if (y == 1) {
+      if (!_operands)
+        return {"PREFIX ?", 2};
+      const u8 op = bytes[0];
+      const u8 bx = op >> 6, by = op >> 3 & 7, bz = op & 7;
+      if (bx == 0)
+        return {std::string(SHIFT[by]) + " " + R8[bz], 2};
+      const char *names[] = {"", "BIT", "RES", "SET"};
+      return {std::string(names[bx]) + " " + std::to_string(by) + ", " +
+                  R8[bz],
+              2};
+    }
+    if (y == 6)
+      return {"DI", 1};
+    if (y == 7)
+      return {"EI", 1};
+    break;
+  case 4:
+    if (y < 4)
+      return {std::string("CALL ") + CONDITION[y] + ", " + n16, 3};
+    break;
+  case 5:
+    if (q == 0)
+      return {std::string("PUSH ") + R16_AF[p], 1};
+    if (p == 0)
+      return {"CALL " + n16, 3};
+    break;
+  case 6:
+    return {std::string(ALU[y]) + " A, " + n8, 2};
+  default:
+    return {"RST " + hex(y * 8u, 2), 1};
+  }
+  return {"ILLEGAL " + hex(_opcode, 2), 1};
+}
+
+// operand bytes of _record: kept in the trace, or taken from the ROM
+auto operands(const trace_record &_record, const std::vector<u8> &_rom,
+              u8 (&_bytes)[2]) -> const u8 * {
+  if (_record.pc >= 0x8000)
+    return _record.operands;
+  const std::size_t at =
+      static_cast<std::size_t>(_record.bank) * 0x4000 + (_record.pc & 0x3FFF);
+  if (at + 2 >= _rom.size())
+    return nullptr;
+  _bytes[0] = _rom[at + 1];
+  _bytes[1] = _rom[at + 2];
+  return _bytes;
+}
+
+auto print(const trace_record &_record, const std::vector<u8> &_rom) -> void {
+  u8 buffer[2];
+  const u8 *bytes = operands(_record, _rom, buffer);
+  const instruction decoded = disassemble(_record.opcode, bytes, _record.pc);
+
+  std::string code = hex(_record.opcode, 2).substr(2);
+  for (u8 i = 1; i < decoded.length; ++i)
+    code += bytes ? " " + hex(bytes[i - 1], 2).substr(2) : " ??";
+
+  // register pairs hold their first register in the low byte
+  std::printf("%12llu  %02x:%04x  %-8s  %-20s  AF=%02x%02x BC=%02x%02x "
+              "DE=%02x%02x HL=%02x%02x SP=%04x%s\n",
+              _record.clock, _record.bank, _record.pc, code.c_str(),
+              decoded.text.c_str(), _record.af & 0xFF, _record.af >> 8,
+              _record.bc & 0xFF, _record.bc >> 8, _record.de & 0xFF,
+              _record.de >> 8, _record.hl & 0xFF, _record.hl >> 8,
+              _record.sp, _record.ime ? " IME" : "");
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t last = 0;
+  std::string rom_path;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--last" && i + 1 < argc)
+      last = std::stoull(argv[++i]);
+    else if (arg == "--rom" && i + 1 < argc)
+      rom_path = argv[++i];
+    else
+      path = arg;
+  }
+  if (path.empty()) {
+    std::cerr << "usage: gboy-trace [--rom file.gb] [--last N] file"
+              << std::endl;
+    return 2;
+  }
+
+  try {
+    std::vector<u8> rom;
+    if (!rom_path.empty()) {
+      std::ifstream file(rom_path, std::ios::binary);
+      if (!file)
+        throw mpu_runtime_error("cannot open " + rom_path);
+      rom.assign(std::istreambuf_iterator<char>(file), {});
+    }
+    u64 count = 0;
+    const std::vector<trace_record> records = trace_ring::load(path, count);
+    const std::size_t first =
+        last && last < records.size() ? records.size() - last : 0;
+    for (std::size_t i = first; i < records.size(); ++i)
+      print(records[i], rom);
+    std::cout << records.size() - first << " of " << count
+              << " instructions traced" << std::endl;
+  } catch (std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}